@@ -1,9 +1,36 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <unordered_set>
+#include <string_view>
 #include <unordered_map>
-#include <cctype>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 enum TokenType {
     KEYWORD_VAR,         
@@ -37,425 +64,3117 @@ enum TokenType {
     DELIMITER_RPAREN,    
     DELIMITER_COMMA,     
     IDENTIFIER,          
-    NUMBER,              
-    ERROR                
+    NUMBER,
+    ERROR,
+    END_OF_INPUT         // 输入结束哨兵
+};
+
+// token类型名，顺序与TokenType一致（统计输出用）
+inline const char* const TOKEN_TYPE_NAMES[] = {
+    "KEYWORD_VAR", "KEYWORD_INTEGER", "KEYWORD_LONGINT", "KEYWORD_BOOL",
+    "KEYWORD_IF", "KEYWORD_THEN", "KEYWORD_ELSE", "KEYWORD_WHILE",
+    "KEYWORD_DO", "KEYWORD_FOR", "KEYWORD_BEGIN", "KEYWORD_END",
+    "KEYWORD_AND", "KEYWORD_OR", "OPERATOR_PLUS", "OPERATOR_MINUS",
+    "OPERATOR_MULTIPLY", "OPERATOR_DIVIDE", "OPERATOR_ASSIGN", "OPERATOR_LT",
+    "OPERATOR_GT", "OPERATOR_NE", "OPERATOR_GE", "OPERATOR_LE", "OPERATOR_EQ",
+    "DELIMITER_SEMICOLON", "DELIMITER_COLON", "DELIMITER_LPAREN",
+    "DELIMITER_RPAREN", "DELIMITER_COMMA", "IDENTIFIER", "NUMBER", "ERROR",
+    "END_OF_INPUT"};
+
+// ===== 结构化诊断 =====
+// 错误在产生点只记录错误码+源偏移+细节区间（POD条目），文本到
+// 输出前才统一格式化。下游工具按码和偏移消费，不用正则拆中文
+enum class DiagCode : uint16_t {
+    EmptyProgram,
+    CannotOpenFile,
+    DuplicateVariable,
+    MissingVarKeyword,
+    MissingBegin,
+    MissingProgramEnd,
+    InvalidKeyword,
+    InvalidLeadingToken,
+    ExpectIdentAfterComma,
+    InvalidIdentifier,
+    MissingCommaBetweenIdents,
+    MissingColonAfterVars,
+    ExpectTypeKeyword,
+    MissingSemicolonAfterDecl,
+    UndefinedVarInCondition,
+    UnclosedParenInCondition,
+    ExpectOperandInCondition,
+    MissingEndForBlock,
+    InvalidTokenInBody,
+    UndefinedVariable,
+    MissingAssignOperator,
+    ExpectValueAfterAssign,
+    UndefinedVarInAssignment,
+    MissingSemicolonAfterAssign,
+    MissingParenAfterWhile,
+    UnclosedParenInWhile,
+    MissingDoAfterWhile,
+    MissingParenAfterIf,
+    UnclosedParenInIf,
+    MissingThenAfterIf,
+    ExtraEnd,
+    MissingSemicolonAfterEnd,
+    ElseWithoutIf,
+    UnexpectedToken,
+    BadTokenBlob,
+    NumberOutOfRange,
+    DuplicateVariableAcrossUnits,
+    AssignTypeMismatch,
+};
+
+// 格式化模板：文本 = 前缀 + 细节 + 后缀，顺序与DiagCode一致
+struct DiagFormat {
+    const char* prefix;
+    const char* suffix;
+};
+inline const DiagFormat DIAG_FORMATS[] = {
+    {"程序为空", ""},
+    {"无法打开文件: ", ""},
+    {"变量重复定义: ", ""},
+    {"程序起始缺少合法的 'var'", ""},
+    {"定义部分后缺少 'begin'", ""},
+    {"程序结束处缺少 'end'", ""},
+    {"无效的关键词: ", ""},
+    {"未定义有效标识符: ", ""},
+    {"逗号后期望标识符", ""},
+    {"无效的标识符: ", ""},
+    {"标识符之间缺少逗号", ""},
+    {"变量后缺少 ':'", ""},
+    {"期望类型 (integer, longint, bool)，找到: ", ""},
+    {"变量声明后缺少 ';'", ""},
+    {"条件中未定义的变量: ", ""},
+    {"条件中括号未闭合", ""},
+    {"条件中期望操作数，找到: ", ""},
+    {"缺少 'end' 来匹配 ", ""},
+    {"实现部分中的无效令牌: ", ""},
+    {"未定义的变量: ", ""},
+    {"标识符后缺少 ':=': ", ""},
+    {"':=' 后期望数字或标识符，找到: ", ""},
+    {"赋值中未定义的变量: ", ""},
+    {"赋值后缺少 ';'", ""},
+    {"while 后缺少 '('", ""},
+    {"while 条件中括号未闭合", ""},
+    {"while 条件后缺少 'do'", ""},
+    {"if 后缺少 '('", ""},
+    {"if 条件中括号未闭合", ""},
+    {"if 条件后缺少 'then'", ""},
+    {"多余的 'end'", ""},
+    {"", " 的 'end' 后缺少 ';'"},
+    {"'else' 未匹配到 'if'", ""},
+    {"意外的token: ", ""},
+    {"无效的token流: ", ""},
+    {"数字字面量超出类型范围: ", ""},
+    {"跨单元变量重复定义: ", ""},
+    {"赋值类型不匹配: ", ""},
+};
+
+// 错误码名（NDJSON输出用），顺序与DiagCode一致
+inline const char* const DIAG_NAMES[] = {
+    "EmptyProgram", "CannotOpenFile", "DuplicateVariable", "MissingVarKeyword",
+    "MissingBegin", "MissingProgramEnd", "InvalidKeyword", "InvalidLeadingToken",
+    "ExpectIdentAfterComma", "InvalidIdentifier", "MissingCommaBetweenIdents",
+    "MissingColonAfterVars", "ExpectTypeKeyword", "MissingSemicolonAfterDecl",
+    "UndefinedVarInCondition", "UnclosedParenInCondition",
+    "ExpectOperandInCondition", "MissingEndForBlock", "InvalidTokenInBody",
+    "UndefinedVariable", "MissingAssignOperator", "ExpectValueAfterAssign",
+    "UndefinedVarInAssignment", "MissingSemicolonAfterAssign",
+    "MissingParenAfterWhile", "UnclosedParenInWhile", "MissingDoAfterWhile",
+    "MissingParenAfterIf", "UnclosedParenInIf", "MissingThenAfterIf", "ExtraEnd",
+    "MissingSemicolonAfterEnd", "ElseWithoutIf", "UnexpectedToken",
+    "BadTokenBlob", "NumberOutOfRange", "DuplicateVariableAcrossUnits",
+    "AssignTypeMismatch"};
+
+// POD诊断条目；细节文本集中存放在分析器的细节池里
+struct Diagnostic {
+    uint16_t code;         // DiagCode
+    uint32_t offset;       // 发现位置的源偏移
+    uint32_t detailOffset; // 细节在池中的起始
+    uint32_t detailLength; // 细节长度
+};
+
+// ===== 检查级别 =====
+// Analyzer的两种运行形态：Full做全部检查；LexOnly只做词法与
+// 块配对预筛（预筛量是全检的十倍）。级别是模板参数，预筛实例化
+// 在编译期裁掉符号表探测、类型检查与声明名单收集，不付运行期分支
+enum class CheckLevel : uint8_t {
+    Full,    // 全部检查：符号表、类型、范围
+    LexOnly, // 预筛：词法有效性与结构配对，无符号表操作
+};
+
+// ===== 扁平AST =====
+// 解析器本身只校验不建树，下游（翻译器、度量、死存储检查）各自从
+// 原始token流重推结构。开启建树模式后，节点按前序追加进平坦数组，
+// 子节点以u32下标相连（firstChild/nextSibling），节点内无指针，
+// 整块可memcpy/序列化，消费方按数组序即得前序遍历
+enum class NodeKind : uint8_t {
+    Program,   // 根；子节点为声明与语句
+    VarDecl,   // 单个变量声明；aux为VarType
+    Assign,    // 赋值语句；子节点为VarRef与右值
+    VarRef,    // 变量引用
+    NumberLit, // 数字字面量
+};
+
+inline const char* const NODE_KIND_NAMES[] = {"Program", "VarDecl", "Assign",
+                                              "VarRef", "NumberLit"};
+
+struct AstNode {
+    uint8_t kind;         // NodeKind
+    uint8_t aux;          // VarDecl: VarType；其余为0
+    uint32_t offset;      // 对应源区间起点
+    uint32_t length;      // 对应源区间长度
+    uint32_t firstChild;  // 首个子节点下标，0表示无（0号恒为根）
+    uint32_t nextSibling; // 下一个兄弟下标，0表示无
 };
 
 struct Token {
     TokenType type;   // token类型
-    std::string value; // token值
+    uint32_t offset;  // 在源缓冲区中的起始偏移
+    uint32_t length;  // token长度
 };
 
-class Analyzer {
+// 字符类别位掩码，词法器内循环按字节查表，一次load+mask完成分类
+enum CharClass : uint8_t {
+    CHAR_SPACE = 1 << 0, // 空白
+    CHAR_ALPHA = 1 << 1, // 字母
+    CHAR_DIGIT = 1 << 2, // 数字
+    CHAR_DELIM = 1 << 3  // 分隔符/运算符起始字符
+};
+
+// 编译期构建的256项分类表，替代逐字符的 isspace/isalpha/isdigit
+// 和12次比较的 isDelimiter 链
+constexpr std::array<uint8_t, 256> makeCharTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; c++) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f')
+            table[c] |= CHAR_SPACE;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            table[c] |= CHAR_ALPHA;
+        if (c >= '0' && c <= '9')
+            table[c] |= CHAR_DIGIT;
+    }
+    for (char c : {';', ':', ',', '(', ')', '+', '-', '*', '/', '<', '>', '='})
+        table[static_cast<unsigned char>(c)] |= CHAR_DELIM;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> CHAR_TABLE = makeCharTable();
+
+// 判断字符是否属于掩码指定的类别
+inline bool charIs(char c, uint8_t mask) {
+    return (CHAR_TABLE[static_cast<unsigned char>(c)] & mask) != 0;
+}
+
+// ===== 编译期算符DFA =====
+// readOperator 原来对 ':=' '<>' '<=' '>=' '==' 的双字符前瞻是一长串
+// 分支，算符密集的输入上预测失败开销明显。这里在编译期铺一张
+// 状态×字节 的转移表，运行期逐字节查表走最长匹配；单字符算符、
+// 双字符算符和非法字符统一由同一个循环产出，分支只剩循环条件。
+// 标识符/数字/空白的长串扫描仍走向量化内核，不并入自动机
+namespace opdfa {
+
+// 状态编号；START之外每个状态都是接受态，接受的类型见 accept 表
+enum : uint8_t {
+    START = 0,
+    A_PLUS, A_MINUS, A_MUL, A_DIV,       // 单字符算符
+    A_SEMI, A_LPAREN, A_RPAREN, A_COMMA, // 单字符界符
+    A_COLON, A_LT, A_GT,                 // 可续接的前缀
+    A_EQ1, A_BAD,                        // 单独'='与非法字符（均为ERROR）
+    A_ASSIGN, A_NE, A_LE, A_GE, A_EQ2,   // 双字符算符
+    STATE_COUNT,
+    DEAD = 255 // 不可转移：当前状态即最长匹配
+};
+
+struct Tables {
+    uint8_t next[STATE_COUNT][256]; // 状态×输入字节 -> 下一状态
+    TokenType accept[STATE_COUNT];  // 停在该状态时产出的token类型
+};
+
+constexpr Tables makeTables() {
+    Tables t{};
+    for (int s = 0; s < STATE_COUNT; s++) {
+        for (int c = 0; c < 256; c++) t.next[s][c] = DEAD;
+        t.accept[s] = ERROR;
+    }
+    // 起始状态：任何字节都至少吃进一个，未识别的字节进A_BAD
+    for (int c = 0; c < 256; c++) t.next[START][c] = A_BAD;
+    t.next[START]['+'] = A_PLUS;
+    t.next[START]['-'] = A_MINUS;
+    t.next[START]['*'] = A_MUL;
+    t.next[START]['/'] = A_DIV;
+    t.next[START][';'] = A_SEMI;
+    t.next[START]['('] = A_LPAREN;
+    t.next[START][')'] = A_RPAREN;
+    t.next[START][','] = A_COMMA;
+    t.next[START][':'] = A_COLON;
+    t.next[START]['<'] = A_LT;
+    t.next[START]['>'] = A_GT;
+    t.next[START]['='] = A_EQ1;
+    // 双字符续接
+    t.next[A_COLON]['='] = A_ASSIGN;
+    t.next[A_LT]['>'] = A_NE;
+    t.next[A_LT]['='] = A_LE;
+    t.next[A_GT]['='] = A_GE;
+    t.next[A_EQ1]['='] = A_EQ2;
+
+    t.accept[A_PLUS] = OPERATOR_PLUS;
+    t.accept[A_MINUS] = OPERATOR_MINUS;
+    t.accept[A_MUL] = OPERATOR_MULTIPLY;
+    t.accept[A_DIV] = OPERATOR_DIVIDE;
+    t.accept[A_SEMI] = DELIMITER_SEMICOLON;
+    t.accept[A_LPAREN] = DELIMITER_LPAREN;
+    t.accept[A_RPAREN] = DELIMITER_RPAREN;
+    t.accept[A_COMMA] = DELIMITER_COMMA;
+    t.accept[A_COLON] = DELIMITER_COLON;
+    t.accept[A_LT] = OPERATOR_LT;
+    t.accept[A_GT] = OPERATOR_GT;
+    t.accept[A_EQ1] = ERROR; // 单独的 '=' 是无效的
+    t.accept[A_BAD] = ERROR;
+    t.accept[A_ASSIGN] = OPERATOR_ASSIGN;
+    t.accept[A_NE] = OPERATOR_NE;
+    t.accept[A_LE] = OPERATOR_LE;
+    t.accept[A_GE] = OPERATOR_GE;
+    t.accept[A_EQ2] = OPERATOR_EQ;
+    return t;
+}
+
+inline constexpr Tables TABLES = makeTables();
+
+} // namespace opdfa
+
+// ===== 向量化扫描内核 =====
+// 词法热点是整段空白、标识符长串和数字串的扫描。这里提供一次步进
+// 16/32字节的内核，启动时按CPU能力选择 AVX2/SSE2/标量实现。
+namespace scan {
+
+// 标量回退：逐字节查 CHAR_TABLE
+inline size_t scalarSkipSpace(const char* data, size_t len, size_t pos) {
+    while (pos < len && (CHAR_TABLE[static_cast<unsigned char>(data[pos])] & CHAR_SPACE))
+        pos++;
+    return pos;
+}
+
+inline size_t scalarScanIdent(const char* data, size_t len, size_t pos) {
+    while (pos < len &&
+           !(CHAR_TABLE[static_cast<unsigned char>(data[pos])] & (CHAR_SPACE | CHAR_DELIM)))
+        pos++;
+    return pos;
+}
+
+inline size_t scalarScanDigits(const char* data, size_t len, size_t pos) {
+    while (pos < len && (CHAR_TABLE[static_cast<unsigned char>(data[pos])] & CHAR_DIGIT))
+        pos++;
+    return pos;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+
+// 空白匹配：c == ' ' 或 0x09 <= c <= 0x0D
+inline __m128i spaceMask128(__m128i chunk) {
+    __m128i sp = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+    __m128i ge = _mm_cmpgt_epi8(chunk, _mm_set1_epi8(0x08));
+    __m128i le = _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x0E));
+    return _mm_or_si128(sp, _mm_and_si128(ge, le));
+}
+
+// 标识符终止符匹配：空白，或分隔符区间
+// 0x28-0x2F（去掉 '.'）与 0x3A-0x3E，对应 ;:,()+-*/<>=
+inline __m128i identStopMask128(__m128i chunk) {
+    __m128i r1 = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(0x27)),
+                               _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x30)));
+    r1 = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('.')), r1);
+    __m128i r2 = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(0x39)),
+                               _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x3F)));
+    return _mm_or_si128(spaceMask128(chunk), _mm_or_si128(r1, r2));
+}
+
+// 数字匹配：'0' <= c <= '9'
+inline __m128i digitMask128(__m128i chunk) {
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)),
+                         _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+}
+
+inline size_t sse2SkipSpace(const char* data, size_t len, size_t pos) {
+    while (pos + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        int m = _mm_movemask_epi8(spaceMask128(chunk));
+        if (m != 0xFFFF) return pos + __builtin_ctz(~m & 0xFFFF);
+        pos += 16;
+    }
+    return scalarSkipSpace(data, len, pos);
+}
+
+inline size_t sse2ScanIdent(const char* data, size_t len, size_t pos) {
+    while (pos + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        int m = _mm_movemask_epi8(identStopMask128(chunk));
+        if (m != 0) return pos + __builtin_ctz(m);
+        pos += 16;
+    }
+    return scalarScanIdent(data, len, pos);
+}
+
+inline size_t sse2ScanDigits(const char* data, size_t len, size_t pos) {
+    while (pos + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        int m = _mm_movemask_epi8(digitMask128(chunk));
+        if (m != 0xFFFF) return pos + __builtin_ctz(~m & 0xFFFF);
+        pos += 16;
+    }
+    return scalarScanDigits(data, len, pos);
+}
+
+// AVX2 版本：一次32字节，目标属性允许在非AVX2编译目标下按需启用
+__attribute__((target("avx2")))
+inline __m256i spaceMask256(__m256i chunk) {
+    __m256i sp = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+    __m256i ge = _mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(0x08));
+    __m256i le = _mm256_cmpgt_epi8(_mm256_set1_epi8(0x0E), chunk);
+    return _mm256_or_si256(sp, _mm256_and_si256(ge, le));
+}
+
+__attribute__((target("avx2")))
+inline __m256i identStopMask256(__m256i chunk) {
+    __m256i r1 = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(0x27)),
+                                  _mm256_cmpgt_epi8(_mm256_set1_epi8(0x30), chunk));
+    r1 = _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('.')), r1);
+    __m256i r2 = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(0x39)),
+                                  _mm256_cmpgt_epi8(_mm256_set1_epi8(0x3F), chunk));
+    return _mm256_or_si256(spaceMask256(chunk), _mm256_or_si256(r1, r2));
+}
+
+__attribute__((target("avx2")))
+inline __m256i digitMask256(__m256i chunk) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('0' - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chunk));
+}
+
+__attribute__((target("avx2")))
+inline size_t avx2SkipSpace(const char* data, size_t len, size_t pos) {
+    while (pos + 32 <= len) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(spaceMask256(chunk)));
+        if (m != 0xFFFFFFFFu) return pos + __builtin_ctz(~m);
+        pos += 32;
+    }
+    return sse2SkipSpace(data, len, pos);
+}
+
+__attribute__((target("avx2")))
+inline size_t avx2ScanIdent(const char* data, size_t len, size_t pos) {
+    while (pos + 32 <= len) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(identStopMask256(chunk)));
+        if (m != 0) return pos + __builtin_ctz(m);
+        pos += 32;
+    }
+    return sse2ScanIdent(data, len, pos);
+}
+
+__attribute__((target("avx2")))
+inline size_t avx2ScanDigits(const char* data, size_t len, size_t pos) {
+    while (pos + 32 <= len) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(digitMask256(chunk)));
+        if (m != 0xFFFFFFFFu) return pos + __builtin_ctz(~m);
+        pos += 32;
+    }
+    return sse2ScanDigits(data, len, pos);
+}
+
+#endif // x86 + GNUC
+
+using ScanFn = size_t (*)(const char*, size_t, size_t);
+
+struct Kernels {
+    ScanFn skipSpace;
+    ScanFn scanIdent;
+    ScanFn scanDigits;
+};
+
+// 启动时按CPU能力选一次，之后词法器经函数指针调用
+inline Kernels selectKernels() {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        return {avx2SkipSpace, avx2ScanIdent, avx2ScanDigits};
+    }
+    return {sse2SkipSpace, sse2ScanIdent, sse2ScanDigits}; // x86-64基线保证SSE2
+#else
+    return {scalarSkipSpace, scalarScanIdent, scalarScanDigits};
+#endif
+}
+
+inline const Kernels kernels = selectKernels();
+
+} // namespace scan
+
+// ASCII小写化，不经过locale
+constexpr char lowerChar(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c;
+}
+
+// 逐字节小写比较，调用方保证两者长度一致
+inline bool equalsLower(std::string_view word, std::string_view kw) {
+    for (size_t i = 0; i < word.size(); i++) {
+        if (lowerChar(word[i]) != kw[i]) return false;
+    }
+    return true;
+}
+
+// 关键字识别：按长度分桶后只剩2-4个候选，单遍字节比较，
+// 无小写拷贝、无哈希探测。非关键字返回 ERROR 哨兵。
+inline TokenType classifyKeyword(std::string_view word) {
+    switch (word.size()) {
+        case 2:
+            if (equalsLower(word, "if")) return KEYWORD_IF;
+            if (equalsLower(word, "do")) return KEYWORD_DO;
+            if (equalsLower(word, "or")) return KEYWORD_OR;
+            break;
+        case 3:
+            if (equalsLower(word, "var")) return KEYWORD_VAR;
+            if (equalsLower(word, "end")) return KEYWORD_END;
+            if (equalsLower(word, "and")) return KEYWORD_AND;
+            if (equalsLower(word, "for")) return KEYWORD_FOR;
+            break;
+        case 4:
+            if (equalsLower(word, "bool")) return KEYWORD_BOOL;
+            if (equalsLower(word, "then")) return KEYWORD_THEN;
+            if (equalsLower(word, "else")) return KEYWORD_ELSE;
+            break;
+        case 5:
+            if (equalsLower(word, "while")) return KEYWORD_WHILE;
+            if (equalsLower(word, "begin")) return KEYWORD_BEGIN;
+            break;
+        case 7:
+            if (equalsLower(word, "integer")) return KEYWORD_INTEGER;
+            if (equalsLower(word, "longint")) return KEYWORD_LONGINT;
+            break;
+    }
+    return ERROR;
+}
+
+// 数字串折叠为u64：value*10+digit 逐位累加，溢出用阈值比较累进到
+// 标志位上，循环体内不分支。返回false表示连u64都装不下
+inline bool foldDigits(std::string_view digits, uint64_t& value) {
+    value = 0;
+    bool overflow = false;
+    for (char c : digits) {
+        uint64_t d = static_cast<uint64_t>(c - '0');
+        overflow |= value > (UINT64_MAX - d) / 10;
+        value = value * 10 + d;
+    }
+    return !overflow;
+}
+
+// token区间内容哈希（FNV-1a，类型字节+原文字节），增量会话用它
+// 作为声明/语句单元的记忆化键
+inline uint64_t hashTokenSpan(std::string_view src, const Token* tokens, size_t count) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < count; i++) {
+        h ^= static_cast<uint8_t>(tokens[i].type);
+        h *= 1099511628211ull;
+        std::string_view lexeme = src.substr(tokens[i].offset, tokens[i].length);
+        for (char c : lexeme) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+// ===== 单调内存池 =====
+// 每个 Analyzer 持有一个：token缓冲、错误文本和解析器的临时向量都
+// 从这里按指针递增分配，Analyzer 析构时整池释放。批处理的工作线程
+// 各用各的池，不再在全局 malloc 锁上互相排队。
+class Arena {
 public:
-    Analyzer(const std::string& src) : source(src), pos(0), tokenPos(0) {
-        keywords = {"var", "integer", "longint", "bool", "if", "then", "else",
-                    "while", "do", "for", "begin", "end", "and", "or"};
-        types = {"integer", "longint", "bool"};
+    void* allocate(size_t bytes, size_t align) {
+        size_t misalign = reinterpret_cast<uintptr_t>(cur) & (align - 1);
+        size_t padding = misalign ? align - misalign : 0;
+        if (remaining < bytes + padding) {
+            grow(bytes + align);
+            misalign = reinterpret_cast<uintptr_t>(cur) & (align - 1);
+            padding = misalign ? align - misalign : 0;
+        }
+        cur += padding;
+        remaining -= padding;
+        void* result = cur;
+        cur += bytes;
+        remaining -= bytes;
+        return result;
     }
 
-    void analyze() {
-        tokens = tokenize();
-        if (tokens.empty()) {
-            errors.push_back("程序为空");
-        } else {
-            parse();
+    // 复位分配游标但保留已申请的块，下一轮从头复用；调用方必须
+    // 同时丢弃所有指向池内存的容器（见 Analyzer::reset）
+    void reset() {
+        active = 0;
+        cur = nullptr;
+        remaining = 0;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024; // 块大小，超大请求单独成块
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void grow(size_t atLeast) {
+        size_t need = atLeast > BLOCK_SIZE ? atLeast : BLOCK_SIZE;
+        // 先尝试复用reset保留下来的块，容量不足的跳过
+        while (active < blocks.size() && blocks[active].size < need) active++;
+        if (active == blocks.size()) {
+            blocks.push_back({std::unique_ptr<char[]>(new char[need]), need});
+            totalBytes += need;
+        }
+        cur = blocks[active].data.get();
+        remaining = blocks[active].size;
+        active++;
+    }
+
+    std::vector<Block> blocks; // 已申请的块，析构时整体释放
+    size_t active = 0;         // 下一个可复用块的下标
+    char* cur = nullptr;       // 当前块内的分配游标
+    size_t remaining = 0;      // 当前块剩余字节
+    size_t totalBytes = 0;     // 累计申请的块字节数
+
+public:
+    size_t bytesReserved() const { return totalBytes; }
+    size_t blockCount() const { return blocks.size(); }
+};
+
+// 全局分配计数：基准测试用来报告一次分析触发了多少次堆分配。
+// 计数常开，基准前后取快照做差即可，对热路径只多一次宽松原子加
+inline std::atomic<uint64_t> g_heapAllocCount{0};
+inline std::atomic<uint64_t> g_heapAllocBytes{0};
+
+// GCC内联替换版new/delete后看到 malloc 配 free，在 -O2 -Wall 下误报
+// -Wmismatched-new-delete；两侧确实同用 malloc/free，就地压掉
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t bytes) {
+    g_heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+    g_heapAllocBytes.fetch_add(bytes, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// 标准容器到 Arena 的适配器；单调池不做逐个回收，deallocate 为空
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena& a) : arena(&a) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+// ===== SoA token流 =====
+// 类型、偏移、长度分列存放。解析器的分派循环几乎只看类型，密集的
+// u8类型数组一条缓存行能装64个token，不再把偏移和长度一起拖进缓存
+class TokenStream {
+public:
+    explicit TokenStream(Arena& arena)
+        : types(ArenaAllocator<uint8_t>(arena)),
+          offsets(ArenaAllocator<uint32_t>(arena)),
+          lengths(ArenaAllocator<uint32_t>(arena)) {}
+
+    size_t size() const { return types.size(); }
+    bool empty() const { return types.empty(); }
+
+    TokenType typeAt(size_t i) const { return static_cast<TokenType>(types[i]); }
+    uint32_t offsetAt(size_t i) const { return offsets[i]; }
+    uint32_t lengthAt(size_t i) const { return lengths[i]; }
+
+    // 聚合视图，需要完整token的少数路径用
+    Token at(size_t i) const { return {typeAt(i), offsets[i], lengths[i]}; }
+
+    void push(const Token& token) {
+        types.push_back(static_cast<uint8_t>(token.type));
+        offsets.push_back(token.offset);
+        lengths.push_back(token.length);
+    }
+
+    void clear() {
+        types.clear();
+        offsets.clear();
+        lengths.clear();
+    }
+
+    void reserve(size_t n) {
+        types.reserve(n);
+        offsets.reserve(n);
+        lengths.reserve(n);
+    }
+
+    // 区间内容哈希，与 hashTokenSpan 同构（记忆化键用）
+    uint64_t hashSpan(std::string_view src, size_t from, size_t count) const {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = from; i < from + count; i++) {
+            h ^= types[i];
+            h *= 1099511628211ull;
+            std::string_view lexeme = src.substr(offsets[i], lengths[i]);
+            for (char c : lexeme) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 1099511628211ull;
+            }
         }
-        reportErrors();
+        return h;
     }
 
 private:
-    std::string source;                          
-    size_t pos;                                  
-    std::vector<Token> tokens;                   
-    size_t tokenPos;                             
-    std::unordered_set<std::string> keywords;    // 关键字集合
-    std::unordered_set<std::string> types;       // 类型集合
-    std::unordered_map<std::string, std::string> symbolTable; // 符号表 标识符 -> 类型
-    std::vector<std::string> errors;             // 错误信息列表
-
-    std::string toLower(const std::string& str) {
-        std::string lower;
-        for (char c : str) {
-            lower += std::tolower(static_cast<unsigned char>(c));
-        }
-        return lower; 
-    }
-
-    TokenType getKeywordType(const std::string& keyword) {
-        if (keyword == "var") return KEYWORD_VAR;
-        if (keyword == "integer") return KEYWORD_INTEGER;
-        if (keyword == "longint") return KEYWORD_LONGINT;
-        if (keyword == "bool") return KEYWORD_BOOL;
-        if (keyword == "if") return KEYWORD_IF;
-        if (keyword == "then") return KEYWORD_THEN;
-        if (keyword == "else") return KEYWORD_ELSE;
-        if (keyword == "while") return KEYWORD_WHILE;
-        if (keyword == "do") return KEYWORD_DO;
-        if (keyword == "for") return KEYWORD_FOR;
-        if (keyword == "begin") return KEYWORD_BEGIN;
-        if (keyword == "end") return KEYWORD_END;
-        if (keyword == "and") return KEYWORD_AND;
-        if (keyword == "or") return KEYWORD_OR;
-        return ERROR; // 返回关键字对应的令牌类型
-    }
-
-    std::vector<Token> tokenize() {
-        std::vector<Token> tokens;
-        while (pos < source.length()) {
-            char c = source[pos];
-            if (std::isspace(c)) {
-                pos++; 
-            } else if (std::isalpha(c)) {
-                tokens.push_back(readIdentifierOrKeyword()); 
-            } else if (std::isdigit(c)) {
-                tokens.push_back(readNumber()); 
-            } else {
-                tokens.push_back(readOperator());
+    ArenaVector<uint8_t> types;    // token类型，解析分派的热数组
+    ArenaVector<uint32_t> offsets; // 源偏移
+    ArenaVector<uint32_t> lengths; // 源长度
+};
+
+// ===== token流二进制序列化 =====
+// 词法一次、解析多次：下游工具加载序列化的token流，跳过重复词法。
+// 格式：魔数"PTK1" + varint源长度 + varint token数，随后每个token为
+// 类型1字节 + 偏移增量varint + 长度varint（偏移单调递增，增量很小）
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// 读失败（越界/截断）返回false
+inline bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) return false;
+        unsigned char byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+inline constexpr char TOKEN_BLOB_MAGIC[4] = {'P', 'T', 'K', '1'};
+
+// 变量类型，符号表里只存这个小枚举，不再存类型名字符串
+enum class VarType : uint8_t {
+    Integer,
+    Longint,
+    Bool
+};
+
+// ===== 字符串驻留器 =====
+// 标识符首次出现时驻留为稠密u32 ID（0,1,2,...），之后符号表的所有
+// 操作都以ID为键走平坦数组。开放寻址、FNV-1a哈希；槽里缓存完整
+// 哈希值，绝大多数探测一次整数比较即可跳过。
+class Interner {
+public:
+    // 返回name的ID，未见过的name分配下一个稠密ID
+    uint32_t intern(std::string_view name) {
+        if ((count + 1) * 4 > capacity * 3) rehash(); // 负载因子保持在3/4以下
+        size_t h = fnv1a(name);
+        size_t i = h & (capacity - 1);
+        while (slots[i].id != EMPTY) {
+            probes++;
+            if (slots[i].hash == h && slots[i].name == name) return slots[i].id;
+            i = (i + 1) & (capacity - 1);
+        }
+        probes++;
+        misses++;
+        slots[i] = {h, name, count};
+        names.push_back(name);
+        return count++;
+    }
+
+    std::string_view name(uint32_t id) const { return names[id]; }
+    uint32_t size() const { return count; }
+    uint64_t probeCount() const { return probes; }
+    uint64_t missCount() const { return misses; }
+
+    // 清空条目但保留槽位数组容量，跨文件复用时不再rehash扩容
+    void clear() {
+        for (auto& slot : slots) slot = Slot{};
+        names.clear();
+        count = 0;
+        probes = 0;
+        misses = 0;
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Slot {
+        size_t hash = 0;
+        std::string_view name;
+        uint32_t id = EMPTY;
+    };
+
+    static size_t fnv1a(std::string_view s) {
+        size_t h = 14695981039346656037ull;
+        for (char c : s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    void rehash() {
+        size_t newCapacity = capacity ? capacity * 2 : 64;
+        std::vector<Slot> newSlots(newCapacity);
+        for (const auto& slot : slots) {
+            if (slot.id == EMPTY) continue;
+            size_t i = slot.hash & (newCapacity - 1);
+            while (newSlots[i].id != EMPTY) i = (i + 1) & (newCapacity - 1);
+            newSlots[i] = slot;
+        }
+        slots = std::move(newSlots);
+        capacity = newCapacity;
+    }
+
+    std::vector<Slot> slots;              // 开放寻址槽位，容量为2的幂
+    std::vector<std::string_view> names;  // ID -> 名字（指向源缓冲的视图）
+    size_t capacity = 0;
+    uint32_t count = 0;
+    uint64_t probes = 0;  // 槽位探测总数（含命中那次）
+    uint64_t misses = 0;  // 未命中（新插入）次数
+};
+
+// ===== 跨单元共享符号表 =====
+// 生成的程序把同一个声明命名空间拆在多个单元文件里；此前为了让
+// 重复定义检查看到全局，只能把文件拼成一个大字符串单线程分析。
+// 这里按名字哈希分片，每片一把锁，多个Analyzer并行注册声明，
+// 锁竞争被摊薄到片上；片内开放寻址，名字拷贝一次由表持有
+class SharedSymbolTable {
+public:
+    // 注册声明；该名字已被注册过则返回false（跨单元重复定义）
+    bool registerDecl(std::string_view name, VarType type) {
+        size_t h = fnv1a(name);
+        Shard& shard = shards[h & (SHARD_COUNT - 1)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if ((shard.count + 1) * 4 > shard.slots.size() * 3) rehash(shard);
+        size_t i = (h >> SHARD_BITS) & (shard.slots.size() - 1);
+        while (!shard.slots[i].name.empty()) {
+            if (shard.slots[i].hash == h && shard.slots[i].name == name) {
+                return false;
             }
+            i = (i + 1) & (shard.slots.size() - 1);
         }
-        return tokens; // 返回令牌列表
+        shard.slots[i] = {h, std::string(name), type};
+        shard.count++;
+        return true;
     }
 
-    Token readIdentifierOrKeyword() {
-        std::string tokenStr;
+private:
+    static constexpr size_t SHARD_BITS = 4;
+    static constexpr size_t SHARD_COUNT = 1 << SHARD_BITS; // 16片
 
-        while (pos < source.length() && !std::isspace(source[pos]) && !isDelimiter(source[pos])) {
-            tokenStr += source[pos];
-            pos++;
+    struct Slot {
+        size_t hash = 0;
+        std::string name; // 空串即空槽
+        VarType type = VarType::Integer;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Slot> slots{64};
+        size_t count = 0;
+    };
+
+    static size_t fnv1a(std::string_view s) {
+        size_t h = 14695981039346656037ull;
+        for (char c : s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static void rehash(Shard& shard) {
+        std::vector<Slot> bigger(shard.slots.size() * 2);
+        for (auto& slot : shard.slots) {
+            if (slot.name.empty()) continue;
+            size_t i = (slot.hash >> SHARD_BITS) & (bigger.size() - 1);
+            while (!bigger[i].name.empty()) i = (i + 1) & (bigger.size() - 1);
+            bigger[i] = std::move(slot);
+        }
+        shard.slots = std::move(bigger);
+    }
+
+    Shard shards[SHARD_COUNT];
+};
+
+// 词法核心：只依赖源视图和游标，不持有共享状态，
+// 多个实例可在不同线程上对同一源缓冲的不同区间并行运行
+struct LexCursor {
+    std::string_view src;  // 完整源缓冲
+    size_t pos = 0;        // 当前扫描位置
+    size_t limit = 0;      // 扫描上界（并行分块时为块尾，须对齐到空白）
+
+    // 产出下一个token，区间耗尽时返回 END_OF_INPUT
+    Token next() {
+        pos = scan::kernels.skipSpace(src.data(), limit, pos); // 整段跳过空白
+        if (pos >= limit) {
+            return {END_OF_INPUT, static_cast<uint32_t>(pos), 0};
+        }
+        char c = src[pos];
+        if (charIs(c, CHAR_ALPHA)) {
+            return readIdentifierOrKeyword();
         }
+        if (charIs(c, CHAR_DIGIT)) {
+            return readNumber();
+        }
+        return readOperator();
+    }
+
+    Token readIdentifierOrKeyword() {
+        uint32_t start = static_cast<uint32_t>(pos);
 
-        std::string lowerToken = toLower(tokenStr);
+        pos = scan::kernels.scanIdent(src.data(), src.length(), pos);
+
+        uint32_t length = static_cast<uint32_t>(pos) - start;
+        std::string_view tokenStr = src.substr(start, length);
 
         // 检查是否为关键字
-        if (keywords.count(lowerToken)) {
-            return {getKeywordType(lowerToken), tokenStr};
+        TokenType keywordType = classifyKeyword(tokenStr);
+        if (keywordType != ERROR) {
+            return {keywordType, start, length};
         }
 
         // 必须以字母开头，之后只允许字母和数字
-        if (!std::isalpha(tokenStr[0])) {
-            return {ERROR, tokenStr}; // 以数字或其他字符开头
+        if (!charIs(tokenStr[0], CHAR_ALPHA)) {
+            return {ERROR, start, length}; // 以数字或其他字符开头
         }
         for (char c : tokenStr) {
-            if (!std::isalnum(c)) {
-                return {ERROR, tokenStr}; // 包含非法字符
+            if (!charIs(c, CHAR_ALPHA | CHAR_DIGIT)) {
+                return {ERROR, start, length}; // 包含非法字符
             }
         }
 
-        return {IDENTIFIER, tokenStr}; // 返回标识符令牌
+        return {IDENTIFIER, start, length}; // 返回标识符令牌
     }
 
-    bool isDelimiter(char c) {
-        return c == ';' || c == ':' || c == ',' || c == '(' || c == ')' || c == '+' || c == '-' ||
-               c == '*' || c == '/' || c == '<' || c == '>' || c == '='; // 判断是否为分隔符
+    Token readNumber() {
+        uint32_t start = static_cast<uint32_t>(pos);
+        pos = scan::kernels.scanDigits(src.data(), src.length(), pos);
+        return {NUMBER, start, static_cast<uint32_t>(pos) - start}; // 返回数字令牌
     }
 
-    Token readNumber() {
-        std::string tokenStr;
-        while (pos < source.length() && std::isdigit(source[pos])) {
-            tokenStr += source[pos];
+    Token readOperator() {
+        uint32_t start = static_cast<uint32_t>(pos);
+        uint8_t state = opdfa::START;
+        while (pos < src.length()) {
+            uint8_t next = opdfa::TABLES.next[state][static_cast<unsigned char>(src[pos])];
+            if (next == opdfa::DEAD) break; // 已是最长匹配
+            state = next;
             pos++;
         }
-        return {NUMBER, tokenStr}; // 返回数字令牌
+        return {opdfa::TABLES.accept[state], start, static_cast<uint32_t>(pos) - start};
     }
+};
 
-    Token readOperator() {
-        char c = source[pos];
-        if (c == '+') { pos++; return {OPERATOR_PLUS, "+"}; }
-        if (c == '-') { pos++; return {OPERATOR_MINUS, "-"}; }
-        if (c == '*') { pos++; return {OPERATOR_MULTIPLY, "*"}; }
-        if (c == '/') { pos++; return {OPERATOR_DIVIDE, "/"}; }
-        if (c == ';') { pos++; return {DELIMITER_SEMICOLON, ";"}; }
-        if (c == '(') { pos++; return {DELIMITER_LPAREN, "("}; }
-        if (c == ')') { pos++; return {DELIMITER_RPAREN, ")"}; }
-        if (c == ',') { pos++; return {DELIMITER_COMMA, ","}; }
-        if (c == ':') {
-            if (pos + 1 < source.length() && source[pos + 1] == '=') {
-                pos += 2;
-                return {OPERATOR_ASSIGN, ":="};
+class Analyzer {
+public:
+    enum class InputMode { String, File }; // 输入模式：内存字符串 / 文件
+
+    Analyzer(const std::string& src) : Analyzer(src, InputMode::String) {}
+
+    Analyzer(const std::string& srcOrPath, InputMode mode) {
+        if (mode == InputMode::String) {
+            ownedSource = srcOrPath;
+            source = ownedSource;
+        } else {
+            loadFile(srcOrPath);
+        }
+        cursor = LexCursor{source, 0, source.length()};
+        eofToken = {END_OF_INPUT, static_cast<uint32_t>(source.length()), 0};
+    }
+
+    Analyzer(const Analyzer&) = delete;
+    Analyzer& operator=(const Analyzer&) = delete;
+
+    ~Analyzer() {
+#ifndef _WIN32
+        if (mapped != nullptr) {
+            munmap(mapped, mappedSize);
+        }
+#endif
+    }
+
+    void analyze() {
+        analyzeQuiet();
+        std::cout << formatReport();
+    }
+
+    // 只做分析不输出，批处理驱动在各工作线程上调用，
+    // 结果经 formatReport() 收集后统一打印。
+    // analyzeQuiet<CheckLevel::LexOnly>() 实例化预筛管线
+    template <CheckLevel L = CheckLevel::Full>
+    void analyzeQuiet() {
+        if (!errors.empty()) { // 文件打开失败等输入错误
+            return;
+        }
+        // 统计模式把交错的词法/语法拆成两个可计时的阶段：
+        // 先整体token化并按类型计数，再对缓冲流解析
+        if (statsEnabled) {
+            if (!useBuffered) {
+                auto start = std::chrono::steady_clock::now();
+                Token token;
+                while ((token = cursor.next()).type != END_OF_INPUT) {
+                    buffered.push(token);
+                }
+                std::chrono::duration<double> elapsed =
+                    std::chrono::steady_clock::now() - start;
+                stats.lexSeconds = elapsed.count();
+                bufferedPos = 0;
+                useBuffered = true;
             }
-            pos++;
-            return {DELIMITER_COLON, ":"};
+            for (size_t i = 0; i < buffered.size(); i++) {
+                stats.tokenCounts[buffered.typeAt(i)]++;
+            }
+            stats.tokenTotal = buffered.size();
+        }
+
+        auto parseStart = std::chrono::steady_clock::now();
+        if (peekType() == END_OF_INPUT) {
+            addError(DiagCode::EmptyProgram, 0);
+        } else {
+            parse<L>();
+        }
+        if (statsEnabled) {
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - parseStart;
+            stats.parseSeconds = elapsed.count();
+            stats.internerProbes = interner.probeCount();
+            stats.internerMisses = interner.missCount();
+            stats.peakArenaBytes = arena.bytesReserved();
         }
-        if (c == '<') {
-            if (pos + 1 < source.length()) {
-                if (source[pos + 1] == '>') { pos += 2; return {OPERATOR_NE, "<>"}; }
-                if (source[pos + 1] == '=') { pos += 2; return {OPERATOR_LE, "<="}; }
+    }
+
+    // 把分析结果格式化为文本（与旧 reportErrors 输出一致）
+    std::string formatReport() const {
+        auto start = std::chrono::steady_clock::now();
+        std::string out;
+        if (errors.empty()) {
+            out = "分析成功：未发现错误。\n";
+        } else {
+            out = "发现错误：\n";
+            for (const auto& diag : errors) {
+                out += "- ";
+                formatDiag(diag, out);
+                out += "\n";
             }
-            pos++;
-            return {OPERATOR_LT, "<"};
         }
-        if (c == '>') {
-            if (pos + 1 < source.length() && source[pos + 1] == '=') {
-                pos += 2;
-                return {OPERATOR_GE, ">="};
+        if (statsEnabled) {
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            stats.reportSeconds = elapsed.count();
+        }
+        return out;
+    }
+
+    // JSON字符串转义，NDJSON输出和批量驱动拼file字段共用
+    static void jsonEscape(std::string_view text, std::string& out) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
             }
-            pos++;
-            return {OPERATOR_GT, ">"};
         }
-        if (c == '=') {
-            if (pos + 1 < source.length() && source[pos + 1] == '=') {
-                pos += 2;
-                return {OPERATOR_EQ, "=="};
+    }
+
+    // NDJSON诊断流：每条错误一行，下游工具按码/偏移消费。
+    // file非空时附在每行里，批量输出无需再看外层文本
+    std::string diagnosticsNdjson(std::string_view file = {}) const {
+        std::string out;
+        // 固定字段最长约：5字段键名/标点 + u16码 + 28字节诊断名 + 三个u32
+        // ≈ 110字节，留足余量防截断产生非法JSON
+        char buf[192];
+        for (const auto& diag : errors) {
+            out += "{";
+            if (!file.empty()) {
+                out += "\"file\":\"";
+                jsonEscape(file, out);
+                out += "\",";
             }
-            pos++;
-            return {ERROR, "="}; // 单独的 '=' 是无效的
+            auto [line, col] = resolveLocation(diag.offset);
+            std::snprintf(buf, sizeof(buf),
+                          "\"code\":%u,\"name\":\"%s\",\"offset\":%u,"
+                          "\"line\":%u,\"col\":%u,\"detail\":\"",
+                          diag.code, DIAG_NAMES[diag.code], diag.offset, line, col);
+            out += buf;
+            jsonEscape({detailPool.data() + diag.detailOffset, diag.detailLength},
+                       out);
+            out += "\"}\n";
         }
-        std::string invalid(1, c);
-        pos++;
-        return {ERROR, invalid}; // 返回无效字符的错误令牌
+        return out;
     }
 
-    void parse() {
-        if (tokenPos >= tokens.size() || tokens[tokenPos].type != KEYWORD_VAR) {
-            errors.push_back("程序起始缺少合法的 'var'");
-            return;
+    // 源缓冲视图（结果缓存按内容哈希作键用）
+    std::string_view sourceView() const { return source; }
+
+    // 输入是否加载失败（构造/reset后即带 CannotOpenFile 诊断）
+    bool loadFailed() const {
+        return !errors.empty() &&
+               errors.front().code == static_cast<uint16_t>(DiagCode::CannotOpenFile);
+    }
+
+    // 内存池统计（基准测试报告用）
+    size_t arenaBytesReserved() const { return arena.bytesReserved(); }
+    size_t arenaBlockCount() const { return arena.blockCount(); }
+
+    // ===== 统计面板 =====
+    // 批量跑慢时要能区分是词法、语法还是报告格式化的锅；
+    // 按分析单元输出一行JSON，便于在5万个文件的批次上聚合
+    struct Stats {
+        double lexSeconds = 0;
+        double parseSeconds = 0;
+        double reportSeconds = 0;
+        uint64_t tokenTotal = 0;
+        std::array<uint64_t, END_OF_INPUT + 1> tokenCounts{};
+        uint64_t internerProbes = 0;
+        uint64_t internerMisses = 0;
+        size_t peakArenaBytes = 0;
+    };
+
+    void enableStats() { statsEnabled = true; }
+
+    // 单行JSON；token计数只列非零项
+    std::string statsJson() const {
+        char buf[160];
+        std::string out = "{";
+        std::snprintf(buf, sizeof(buf),
+                      "\"source_bytes\":%zu,\"tokens\":%llu,"
+                      "\"lex_ms\":%.3f,\"parse_ms\":%.3f,\"report_ms\":%.3f",
+                      source.size(),
+                      static_cast<unsigned long long>(stats.tokenTotal),
+                      stats.lexSeconds * 1000.0, stats.parseSeconds * 1000.0,
+                      stats.reportSeconds * 1000.0);
+        out += buf;
+        out += ",\"token_counts\":{";
+        bool first = true;
+        for (size_t i = 0; i <= END_OF_INPUT; i++) {
+            if (stats.tokenCounts[i] == 0) continue;
+            std::snprintf(buf, sizeof(buf), "%s\"%s\":%llu", first ? "" : ",",
+                          TOKEN_TYPE_NAMES[i],
+                          static_cast<unsigned long long>(stats.tokenCounts[i]));
+            out += buf;
+            first = false;
         }
-        tokenPos++; // 跳过 'var'
+        std::snprintf(buf, sizeof(buf),
+                      "},\"interner_probes\":%llu,\"interner_misses\":%llu,"
+                      "\"arena_peak_bytes\":%zu}",
+                      static_cast<unsigned long long>(stats.internerProbes),
+                      static_cast<unsigned long long>(stats.internerMisses),
+                      stats.peakArenaBytes);
+        out += buf;
+        return out;
+    }
 
-        parseDefinitionBody(); 
-        if (errors.empty() && (tokenPos >= tokens.size() || tokens[tokenPos].type != KEYWORD_BEGIN)) {
-            errors.push_back("定义部分后缺少 'begin'");
-            return;
+    // ===== 增量会话接口 =====
+    // 非拥有源视图构造：IncrementalSession 持有源缓冲，Analyzer 只借用
+    struct ViewInput {};
+    Analyzer(std::string_view externalSource, ViewInput) {
+        source = externalSource;
+        cursor = LexCursor{source, 0, source.length()};
+        eofToken = {END_OF_INPUT, static_cast<uint32_t>(source.length()), 0};
+    }
+
+    // 记忆化条目：无错单元的解析结果。声明单元记录其符号效果，
+    // 赋值语句单元命中即整体跳过
+    struct MemoEntry {
+        bool isDeclaration = false;
+        std::vector<std::pair<std::string, VarType>> declared;
+    };
+    using MemoStore = std::unordered_map<uint64_t, MemoEntry>;
+
+    // 把完整token流编码为二进制blob（词法一次、解析多次的产物）。
+    // 尚未token化时先整体token化
+    std::string serializeTokens() {
+        if (!useBuffered) {
+            Token token;
+            while ((token = cursor.next()).type != END_OF_INPUT) {
+                buffered.push(token);
+            }
+            bufferedPos = 0;
+            useBuffered = true;
         }
-        if (!errors.empty()) return; 
-        tokenPos++; // 跳过 'begin'
-        parseRealizationBody(); 
-        if (errors.empty() && (tokenPos >= tokens.size() || tokens[tokenPos].type != KEYWORD_END)) {
-            errors.push_back("程序结束处缺少 'end'");
+        std::string out;
+        out.append(TOKEN_BLOB_MAGIC, sizeof(TOKEN_BLOB_MAGIC));
+        putVarint(out, source.size());
+        putVarint(out, buffered.size());
+        uint32_t prevOffset = 0;
+        for (size_t i = 0; i < buffered.size(); i++) {
+            out += static_cast<char>(buffered.typeAt(i));
+            putVarint(out, buffered.offsetAt(i) - prevOffset);
+            prevOffset = buffered.offsetAt(i);
+            putVarint(out, buffered.lengthAt(i));
         }
+        return out;
     }
 
-    void parseDefinitionBody() {
-        while (tokenPos < tokens.size() && tokens[tokenPos].type != KEYWORD_BEGIN) {
-            if (tokens[tokenPos].type == ERROR) {
-                errors.push_back("无效的关键词: " + tokens[tokenPos].value);
-                tokenPos++;
-                return; 
-            }
-            if (tokens[tokenPos].type != IDENTIFIER) {
-                errors.push_back("未定义有效标识符: " + tokens[tokenPos].value);
-                tokenPos++;
-                return;
+    // 加载序列化的token流，完全跳过词法。blob必须由同一份源序列化
+    // 而来（源长度做一致性校验），失败时报格式错误并返回false
+    bool adoptSerializedTokens(std::string_view blob) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(blob.data());
+        const unsigned char* end = p + blob.size();
+        if (blob.size() < sizeof(TOKEN_BLOB_MAGIC) ||
+            std::memcmp(p, TOKEN_BLOB_MAGIC, sizeof(TOKEN_BLOB_MAGIC)) != 0) {
+            addError(DiagCode::BadTokenBlob, 0, "魔数不符");
+            return false;
+        }
+        p += sizeof(TOKEN_BLOB_MAGIC);
+        uint64_t sourceLen = 0, count = 0;
+        if (!getVarint(p, end, sourceLen) || !getVarint(p, end, count) ||
+            sourceLen != source.size()) {
+            addError(DiagCode::BadTokenBlob, 0, "源长度不符");
+            return false;
+        }
+        buffered.clear();
+        buffered.reserve(count);
+        uint64_t prevOffset = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            if (p >= end) {
+                addError(DiagCode::BadTokenBlob, 0, "流被截断");
+                return false;
             }
-            // 此处已经识别出一个有效的标识符
-            std::string varName = tokens[tokenPos].value;
-            tokenPos++;
-
-            std::vector<std::string> vars = {varName};
-            // 检查到逗号，判断后续是否为标识符或更多的组合
-            while (tokenPos < tokens.size() && tokens[tokenPos].type == DELIMITER_COMMA) {
-                tokenPos++;
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != IDENTIFIER) {
-                    errors.push_back("逗号后期望标识符");
-                    return;
-                }
-                if (tokens[tokenPos].type == ERROR) {
-                    errors.push_back("无效的标识符: " + tokens[tokenPos].value);
-                    tokenPos++;
-                    return;
-                }
-                vars.push_back(tokens[tokenPos].value);
-                tokenPos++;
+            if (*p > END_OF_INPUT) {
+                addError(DiagCode::BadTokenBlob, 0, "无效的token类型");
+                return false;
             }
-            if (tokenPos < tokens.size() && tokens[tokenPos].type == IDENTIFIER) {
-                errors.push_back("标识符之间缺少逗号");
-                return;
+            TokenType type = static_cast<TokenType>(*p++);
+            uint64_t delta = 0, length = 0;
+            if (!getVarint(p, end, delta) || !getVarint(p, end, length)) {
+                addError(DiagCode::BadTokenBlob, 0, "流被截断");
+                return false;
             }
-            // 不是标识符，也不是冒号，说明非法
-            if (tokenPos >= tokens.size() || tokens[tokenPos].type != DELIMITER_COLON) {
-                errors.push_back("变量后缺少 ':'");
-                return;
+            prevOffset += delta;
+            if (prevOffset + length > source.size()) {
+                addError(DiagCode::BadTokenBlob, 0, "偏移越界");
+                return false;
             }
-            tokenPos++;
+            buffered.push({type, static_cast<uint32_t>(prevOffset),
+                           static_cast<uint32_t>(length)});
+        }
+        bufferedPos = 0;
+        useBuffered = true;
+        return true;
+    }
 
+    // ===== 翻译后端 =====
+    // 干净解析后直接从token流和符号表产出C++（对照correct_example.cpp
+    // 的样式：integer->int, longint->long long, bool->bool），写入调用方
+    // 提供的缓冲。省掉外部Python翻译器整个重新词法/解析的进程往返。
+    // 解析有错时不产出，返回false
+    bool translate(std::string& out) {
+        if (!errors.empty()) return false;
 
-            // 开始判断类型
-            if (tokenPos >= tokens.size() || !types.count(toLower(tokens[tokenPos].value))) {
-                errors.push_back("期望类型 (integer, longint, bool)，找到: " +
-                                 (tokenPos < tokens.size() ? tokens[tokenPos].value : "无"));
-                return;
-            }
-            std::string varType = toLower(tokens[tokenPos].value);
-            tokenPos++;
+        // 流式解析已耗尽游标，重新token化一遍（缓冲模式直接复用）
+        std::vector<Token> local;
+        size_t count = buffered.size();
+        if (!useBuffered) {
+            LexCursor fresh{source, 0, source.length()};
+            Token token;
+            while ((token = fresh.next()).type != END_OF_INPUT) local.push_back(token);
+            count = local.size();
+        }
+        auto typeAt = [&](size_t i) {
+            return useBuffered ? buffered.typeAt(i) : local[i].type;
+        };
+        auto lexemeAt = [&](size_t i) {
+            return useBuffered ? text(buffered.at(i)) : text(local[i]);
+        };
+        // Pascal标识符不区分大小写，输出统一小写（J1 -> j1）
+        auto appendLower = [&out](std::string_view lexeme) {
+            for (char c : lexeme) out += lowerChar(c);
+        };
 
-            //前面记录过vars，这里加入符号表（begin end程序主体使用）顺便检查是否重复定义
-            for (const auto& var : vars) {
-                if (symbolTable.count(var)) {
-                    errors.push_back("变量重复定义: " + var);
-                    return;
-                }
-                symbolTable[var] = varType;
+        out += "#include <iostream>\n#include <string>\n\nint main() {\n";
+
+        // 声明区：Var 之后到 Begin 为止的 标识符表:类型; 组
+        size_t i = 0;
+        if (i < count && typeAt(i) == KEYWORD_VAR) i++;
+        while (i < count && typeAt(i) != KEYWORD_BEGIN) {
+            size_t groupStart = i;
+            while (i < count && typeAt(i) != DELIMITER_COLON) i++;
+            const char* cppType = "int";
+            if (i + 1 < count) {
+                TokenType typeKw = typeAt(i + 1);
+                cppType = typeKw == KEYWORD_LONGINT ? "long long"
+                        : typeKw == KEYWORD_BOOL    ? "bool"
+                                                    : "int";
+            }
+            for (size_t j = groupStart; j < i; j++) {
+                if (typeAt(j) != IDENTIFIER) continue;
+                out += "    ";
+                out += cppType;
+                out += ' ';
+                appendLower(lexemeAt(j));
+                out += ";\n";
             }
+            i += 2; // 越过类型关键字
+            if (i < count && typeAt(i) == DELIMITER_SEMICOLON) i++;
+        }
 
-            if (tokenPos >= tokens.size() || tokens[tokenPos].type != DELIMITER_SEMICOLON) {
-                errors.push_back("变量声明后缺少 ';'");
-                return;
+        out += "\n    // Start of translated Pascal main body\n";
+        if (i < count && typeAt(i) == KEYWORD_BEGIN) i++;
+
+        // 语句区：干净解析保证这里只有 标识符:=操作数; 形式
+        while (i < count && typeAt(i) != KEYWORD_END) {
+            if (typeAt(i) == IDENTIFIER && i + 2 < count &&
+                typeAt(i + 1) == OPERATOR_ASSIGN) {
+                out += "    ";
+                appendLower(lexemeAt(i));
+                out += " = ";
+                appendLower(lexemeAt(i + 2));
+                out += ";\n";
+                i += 3;
+                if (i < count && typeAt(i) == DELIMITER_SEMICOLON) i++;
+            } else {
+                i++; // 防御：跳过预期之外的token
             }
-            tokenPos++;
-            //后面返回到循环开始，继续判断下一个定义语句
         }
+        out += "    // End of translated Pascal main body\n\n    return 0;\n}\n";
+        return true;
     }
 
-    void parseRealizationBody() {
-        std::vector<std::string> blockStack; // 用于跟踪 begin, while, if 等结构的配对
-    
-        while (tokenPos < tokens.size() && tokens[tokenPos].type != KEYWORD_END) {
-            if (tokens[tokenPos].type == ERROR) {
-                errors.push_back("实现部分中的无效令牌: " + tokens[tokenPos].value);
-                tokenPos++;
-                return;
-            }
-    
-            // 赋值语句
-            if (tokens[tokenPos].type == IDENTIFIER) {
-                std::string varName = tokens[tokenPos].value;
-                if (!symbolTable.count(varName)) {
-                    errors.push_back("未定义的变量: " + varName);
-                    return;
+    // 文本报告的每条错误末尾附 (第L行第C列)；NDJSON输出恒带行列
+    void enableLocations() { locateErrors = true; }
+
+    // 挂接跨单元共享符号表：声明除进本地符号表外同时注册到共享表，
+    // 与其他单元撞名即报跨单元重复定义
+    void attachSharedSymbols(SharedSymbolTable* table) { sharedSymbols = table; }
+
+    // ===== 扁平AST接口 =====
+    void enableAstBuild() { astEnabled = true; }
+    const AstNode* astData() const { return astNodes.data(); }
+    size_t astSize() const { return astNodes.size(); }
+
+    // 前序缩进打印（调试/下游冒烟用）
+    std::string dumpAst() const {
+        std::string out;
+        if (!astNodes.empty()) dumpAstNode(0, 0, out);
+        return out;
+    }
+
+    // ===== 跨文件复用 =====
+    // 批处理循环里每个文件都新建Analyzer会反复付出池块、驻留器槽位
+    // 和符号数组的扩容成本。reset系列保留这些容量，只清内容。
+    // （关键字/类型数据自 classifyKeyword 起就是编译期常量，无需复位）
+    void reset(std::string_view newSource) {
+        resetCore();
+        ownedSource.assign(newSource.data(), newSource.size());
+        source = ownedSource;
+        cursor = LexCursor{source, 0, source.length()};
+        eofToken = {END_OF_INPUT, static_cast<uint32_t>(source.length()), 0};
+    }
+
+    // 移动版：调用方已把文件读进字符串时避免再拷贝一次
+    void reset(std::string&& newSource) {
+        resetCore();
+        ownedSource = std::move(newSource);
+        source = ownedSource;
+        cursor = LexCursor{source, 0, source.length()};
+        eofToken = {END_OF_INPUT, static_cast<uint32_t>(source.length()), 0};
+    }
+
+    // 文件版：重新走mmap/读取路径
+    void reset(const std::string& path, InputMode mode) {
+        if (mode == InputMode::String) {
+            reset(std::string_view(path));
+            return;
+        }
+        resetCore();
+        ownedSource.clear();
+        loadFile(path);
+        cursor = LexCursor{source, 0, source.length()};
+        eofToken = {END_OF_INPUT, static_cast<uint32_t>(source.length()), 0};
+    }
+
+    // 采用外部维护的token流（增量重词法的产物），解析器直接走缓冲路径
+    void adoptTokens(const std::vector<Token>& externalTokens) {
+        buffered.clear();
+        buffered.reserve(externalTokens.size());
+        for (const Token& token : externalTokens) buffered.push(token);
+        bufferedPos = 0;
+        useBuffered = true;
+    }
+
+    // 挂接跨轮次的记忆化存储；epoch 在声明区内容变化时推进，
+    // 赋值语句的键随之全部失效
+    void attachMemo(MemoStore* store, uint64_t epoch) {
+        memo = store;
+        memoEpoch = epoch;
+    }
+
+    // 诊断文本拷贝（会话要在 Analyzer 的内存池销毁后继续持有）
+    std::vector<std::string> copyErrors() const {
+        std::vector<std::string> out;
+        out.reserve(errors.size());
+        for (const auto& diag : errors) {
+            std::string text;
+            formatDiag(diag, text);
+            out.push_back(std::move(text));
+        }
+        return out;
+    }
+
+    // 错误恢复模式：解析出错后不再止步于第一个错误，而是同步到下一条
+    // 声明/语句继续分析，一遍收集全部诊断（须在 analyze() 之前调用）
+    void enableErrorRecovery() { recoverErrors = true; }
+
+    // 并行分块词法：把源切成按空白对齐的块，各线程独立产出token，
+    // 再按块序拼接成一条完整token流交给解析器。语言没有跨行字符串
+    // 和注释，所以任何空白字节都是安全的切分点，拼接无需修补跨块
+    // token。须在 analyze() 之前调用；小输入自动退回串行流式路径。
+    void lexInParallel(unsigned threadCount = 0) {
+        size_t n = source.length();
+        unsigned workers = threadCount ? threadCount : std::thread::hardware_concurrency();
+        if (workers < 2 || n < PARALLEL_MIN_INPUT) {
+            return; // 不值得并行，保持流式词法
+        }
+
+        // 块边界先按等分取，再向后推到第一个空白字节对齐
+        std::vector<size_t> bounds;
+        bounds.push_back(0);
+        for (unsigned i = 1; i < workers; i++) {
+            size_t b = n * i / workers;
+            if (b < bounds.back()) b = bounds.back(); // 对齐可能越过等分点
+            while (b < n && !charIs(source[b], CHAR_SPACE)) b++;
+            bounds.push_back(b);
+        }
+        bounds.push_back(n);
+
+        std::vector<std::vector<Token>> parts(workers);
+        std::vector<std::thread> threads;
+        threads.reserve(workers);
+        for (unsigned i = 0; i < workers; i++) {
+            threads.emplace_back([this, &parts, &bounds, i] {
+                LexCursor chunk{source, bounds[i], bounds[i + 1]};
+                Token token;
+                while ((token = chunk.next()).type != END_OF_INPUT) {
+                    parts[i].push_back(token);
                 }
-                tokenPos++;
-    
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != OPERATOR_ASSIGN) {
-                    errors.push_back("标识符后缺少 ':=': " + varName);
-                    return;
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        // 按块序拼接进SoA流
+        size_t total = 0;
+        for (const auto& part : parts) total += part.size();
+        buffered.clear();
+        buffered.reserve(total);
+        for (const auto& part : parts) {
+            for (const Token& token : part) buffered.push(token);
+        }
+        bufferedPos = 0;
+        useBuffered = true;
+    }
+
+private:
+    // 复位公共部分：解除旧映射、回卷内存池并重建池上容器、
+    // 清空符号状态；所有容器保留底层容量
+    void resetCore() {
+#ifndef _WIN32
+        if (mapped != nullptr) {
+            munmap(mapped, mappedSize);
+            mapped = nullptr;
+            mappedSize = 0;
+        }
+#endif
+        // 池回卷后旧的池上容器全部失效，必须先整体重建再使用
+        arena.reset();
+        buffered = TokenStream(arena);
+        errors = ArenaVector<Diagnostic>(ArenaAllocator<Diagnostic>(arena));
+        detailPool = ArenaString(ArenaAllocator<char>(arena));
+        interner.clear();
+        symbolTypes.clear();
+        ringHead = 0;
+        ringCount = 0;
+        bufferedPos = 0;
+        useBuffered = false;
+        memo = nullptr;
+        memoEpoch = 0;
+        lastDeclared.clear();
+        astNodes = ArenaVector<AstNode>(ArenaAllocator<AstNode>(arena));
+        astRootLast = 0;
+        sharedSymbols = nullptr;
+        lineStarts.clear();
+        stats = Stats{};
+    }
+
+    std::string ownedSource;                     // 字符串模式（或读取回退）下持有的拷贝
+    void* mapped = nullptr;                      // 文件模式下的 mmap 基址
+    size_t mappedSize = 0;                       // mmap 映射长度
+    std::string_view source;                     // 统一的源缓冲区视图，词法器直接在其上行走
+    LexCursor cursor;                            // 流式模式下的词法游标
+
+    // 拉取式词法接口：小型环形前瞻缓冲，内存占用与输入规模无关
+    static constexpr size_t LOOKAHEAD = 4;       // 环大小，须为2的幂
+    Token ring[LOOKAHEAD];
+    size_t ringHead = 0;                         // 下一个待消费token在环中的位置
+    size_t ringCount = 0;                        // 环中已填充的token数
+
+    Arena arena;                                 // 本实例所有分析期分配的后备池
+
+    // 并行词法产物：拼接好的完整token流（lexInParallel 填充）
+    static constexpr size_t PARALLEL_MIN_INPUT = 1 << 16; // 低于64KB不值得开线程
+    TokenStream buffered{arena};
+    size_t bufferedPos = 0;
+    bool useBuffered = false;
+    Token eofToken{END_OF_INPUT, 0, 0};          // 缓冲耗尽后peek返回的哨兵
+    bool recoverErrors = false;                  // 错误恢复模式开关
+    bool statsEnabled = false;                   // 统计面板开关
+    mutable Stats stats;                         // 各阶段计时与计数
+
+    SharedSymbolTable* sharedSymbols = nullptr; // 跨单元共享符号表（可选挂接）
+
+    // 扁平AST状态（enableAstBuild后生效）
+    bool astEnabled = false;
+    ArenaVector<AstNode> astNodes{ArenaAllocator<AstNode>(arena)};
+    uint32_t astRootLast = 0; // 根的最后一个子节点，串兄弟链用
+
+    // 追加根的直接子节点并接上兄弟链，返回新节点下标
+    uint32_t astAddTopLevel(NodeKind kind, uint8_t aux, uint32_t offset, uint32_t length) {
+        uint32_t idx = static_cast<uint32_t>(astNodes.size());
+        astNodes.push_back({static_cast<uint8_t>(kind), aux, offset, length, 0, 0});
+        if (astRootLast == 0) {
+            astNodes[0].firstChild = idx;
+        } else {
+            astNodes[astRootLast].nextSibling = idx;
+        }
+        astRootLast = idx;
+        return idx;
+    }
+
+    void dumpAstNode(uint32_t idx, int depth, std::string& out) const {
+        const AstNode& node = astNodes[idx];
+        out.append(static_cast<size_t>(depth) * 2, ' ');
+        out += NODE_KIND_NAMES[node.kind];
+        if (node.length > 0) {
+            out += " '";
+            out += source.substr(node.offset, node.length);
+            out += "'";
+        }
+        out += "\n";
+        for (uint32_t child = node.firstChild; child != 0;
+             child = astNodes[child].nextSibling) {
+            dumpAstNode(child, depth + 1, out);
+        }
+    }
+
+    // 记忆化状态（仅增量会话挂接后生效，且要求缓冲token流）
+    MemoStore* memo = nullptr;
+    uint64_t memoEpoch = 0;
+    std::vector<std::pair<std::string_view, VarType>> lastDeclared; // 最近一条声明的符号效果
+
+    static constexpr uint64_t DECL_SALT = 0xA24BAED4963EE407ull;
+
+    // 声明/赋值单元的终点：下一个 ';' 之后；撞上 begin/end 或流尾则
+    // 不是可记忆化的完整单元，返回0
+    size_t findUnitEnd(size_t from) const {
+        for (size_t i = from; i < buffered.size(); i++) {
+            TokenType type = buffered.typeAt(i);
+            if (type == DELIMITER_SEMICOLON) return i + 1;
+            if (type == KEYWORD_BEGIN || type == KEYWORD_END) return 0;
+        }
+        return 0;
+    }
+
+    uint64_t unitKey(size_t from, size_t end, bool isDeclaration) const {
+        uint64_t h = buffered.hashSpan(source, from, end - from);
+        return isDeclaration ? h ^ DECL_SALT
+                             : h ^ (0xD1B54A32D192ED03ull * (memoEpoch + 1));
+    }
+
+    // 声明单元命中：不重新解析，只重放符号效果（重复定义仍须现查，
+    // 因为冲突可能来自其他单元）
+    bool tryMemoDeclaration() {
+        size_t end = findUnitEnd(bufferedPos);
+        if (end == 0) return false;
+        auto it = memo->find(unitKey(bufferedPos, end, true));
+        if (it == memo->end() || !it->second.isDeclaration) return false;
+        for (const auto& entry : it->second.declared) {
+            uint32_t id = interner.intern(entry.first);
+            if (isDeclared(id)) {
+                addError(DiagCode::DuplicateVariable, peek().offset, entry.first);
+            } else {
+                declare(id, entry.second);
+            }
+        }
+        bufferedPos = end;
+        return true;
+    }
+
+    void memoizeDeclaration(size_t unitStart) {
+        MemoEntry entry;
+        entry.isDeclaration = true;
+        for (const auto& decl : lastDeclared) {
+            entry.declared.emplace_back(std::string(decl.first), decl.second);
+        }
+        (*memo)[unitKey(unitStart, bufferedPos, true)] = std::move(entry);
+    }
+
+    // 赋值语句单元命中：上一轮在相同符号环境（epoch）下无错，整体跳过
+    bool tryMemoStatement() {
+        size_t end = findUnitEnd(bufferedPos);
+        if (end == 0) return false;
+        auto it = memo->find(unitKey(bufferedPos, end, false));
+        if (it == memo->end() || it->second.isDeclaration) return false;
+        bufferedPos = end;
+        return true;
+    }
+
+    void memoizeStatement(size_t unitStart) {
+        (*memo)[unitKey(unitStart, bufferedPos, false)] = MemoEntry{};
+    }
+    // 符号表：标识符经 interner 换成稠密ID后按ID索引平坦数组，
+    // -1 表示未声明，其余为 VarType 值
+    Interner interner;
+    std::vector<int8_t> symbolTypes;
+
+    bool isDeclared(uint32_t id) const {
+        return id < symbolTypes.size() && symbolTypes[id] >= 0;
+    }
+
+    VarType typeOf(uint32_t id) const {
+        return static_cast<VarType>(symbolTypes[id]);
+    }
+
+    // 类型能容纳的最大字面量（integer按32位有符号，longint对应long long）
+    static uint64_t maxLiteralOf(VarType type) {
+        return type == VarType::Integer ? 2147483647ull
+                                        : 9223372036854775807ull;
+    }
+
+    // 赋值兼容格：同类型总是可赋，integer可拓宽到longint；
+    // bool与数值类型互不相通
+    static bool assignable(VarType target, VarType source) {
+        return target == source ||
+               (target == VarType::Longint && source == VarType::Integer);
+    }
+
+    void declare(uint32_t id, VarType type) {
+        if (id >= symbolTypes.size()) symbolTypes.resize(id + 1, -1);
+        symbolTypes[id] = static_cast<int8_t>(type);
+    }
+    ArenaVector<Diagnostic> errors{ArenaAllocator<Diagnostic>(arena)}; // POD诊断条目
+    ArenaString detailPool{ArenaAllocator<char>(arena)};               // 各条目细节的集中存放
+    bool locateErrors = false;                 // 文本报告附带行列位置
+    mutable std::vector<uint32_t> lineStarts;  // 升序行首偏移，首次解析位置时构建
+
+    // 行首索引：对源做一遍memchr扫描，之后任意偏移二分即得行列
+    void buildLineIndex() const {
+        lineStarts.push_back(0);
+        const char* base = source.data();
+        const char* p = base;
+        const char* end = base + source.size();
+        while ((p = static_cast<const char*>(
+                    memchr(p, '\n', static_cast<size_t>(end - p)))) != nullptr) {
+            p++;
+            lineStarts.push_back(static_cast<uint32_t>(p - base));
+        }
+    }
+
+    // 偏移 -> {行,列}，均从1计
+    std::pair<uint32_t, uint32_t> resolveLocation(uint32_t offset) const {
+        if (lineStarts.empty()) buildLineIndex();
+        auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+        uint32_t line = static_cast<uint32_t>(it - lineStarts.begin());
+        return {line, offset - lineStarts[line - 1] + 1};
+    }
+
+    // 产生点只记POD条目，细节字节追加进池；文本到flush时才格式化
+    void addError(DiagCode code, uint32_t offset, std::string_view detail = {}) {
+        Diagnostic diag;
+        diag.code = static_cast<uint16_t>(code);
+        diag.offset = offset;
+        diag.detailOffset = static_cast<uint32_t>(detailPool.size());
+        diag.detailLength = static_cast<uint32_t>(detail.size());
+        detailPool.append(detail.data(), detail.size());
+        errors.push_back(diag);
+    }
+
+    // 按模板格式化单条诊断：前缀 + 细节 + 后缀（+可选行列）
+    void formatDiag(const Diagnostic& diag, std::string& out) const {
+        const DiagFormat& format = DIAG_FORMATS[diag.code];
+        out += format.prefix;
+        out.append(detailPool.data() + diag.detailOffset, diag.detailLength);
+        out += format.suffix;
+        if (locateErrors) {
+            auto [line, col] = resolveLocation(diag.offset);
+            char buf[48];
+            std::snprintf(buf, sizeof(buf), " (第%u行第%u列)", line, col);
+            out += buf;
+        }
+    }
+
+    // 文件模式：优先 mmap，失败则回退到流式 read 拷贝
+    void loadFile(const std::string& path) {
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            addError(DiagCode::CannotOpenFile, 0, path);
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, static_cast<size_t>(st.st_size),
+                              PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                mapped = addr;
+                mappedSize = static_cast<size_t>(st.st_size);
+                source = std::string_view(static_cast<const char*>(addr), mappedSize);
+                close(fd);
+                return;
+            }
+        }
+        close(fd);
+#endif
+        // 回退路径：整块读入 ownedSource（Windows 或 mmap 失败时）
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            addError(DiagCode::CannotOpenFile, 0, path);
+            return;
+        }
+        file.seekg(0, std::ios::end);
+        ownedSource.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(&ownedSource[0], static_cast<std::streamsize>(ownedSource.size()));
+        source = ownedSource;
+    }
+
+    // 按需从源缓冲区切出token文本，token本身不持有字符串
+    std::string_view text(const Token& token) const {
+        return source.substr(token.offset, token.length);
+    }
+
+    // 类型关键字判断（integer/longint/bool）
+    static bool isTypeKeyword(TokenType type) {
+        return type == KEYWORD_INTEGER || type == KEYWORD_LONGINT || type == KEYWORD_BOOL;
+    }
+
+    // 类型关键字到 VarType 的映射，调用方保证传入类型关键字
+    static VarType varTypeOf(TokenType type) {
+        switch (type) {
+            case KEYWORD_LONGINT: return VarType::Longint;
+            case KEYWORD_BOOL:    return VarType::Bool;
+            default:              return VarType::Integer;
+        }
+    }
+
+    // 前瞻第k个尚未消费的token；缓冲模式从SoA流聚合出完整token，
+    // 流式模式按需从词法游标拉取补环
+    Token peek(size_t k = 0) {
+        if (useBuffered) {
+            size_t idx = bufferedPos + k;
+            return idx < buffered.size() ? buffered.at(idx) : eofToken;
+        }
+        while (ringCount <= k) {
+            ring[(ringHead + ringCount) & (LOOKAHEAD - 1)] = cursor.next();
+            ringCount++;
+        }
+        return ring[(ringHead + k) & (LOOKAHEAD - 1)];
+    }
+
+    // 只看类型的前瞻：解析器分派循环的主通路，缓冲模式下只碰
+    // 密集的u8类型数组
+    TokenType peekType(size_t k = 0) {
+        if (useBuffered) {
+            size_t idx = bufferedPos + k;
+            return idx < buffered.size() ? buffered.typeAt(idx) : END_OF_INPUT;
+        }
+        return peek(k).type;
+    }
+
+    // 消费当前token（END_OF_INPUT 不可消费，可重复 peek）
+    void advance() {
+        if (useBuffered) {
+            if (bufferedPos < buffered.size()) bufferedPos++;
+            return;
+        }
+        if (peekType() == END_OF_INPUT) return;
+        ringHead = (ringHead + 1) & (LOOKAHEAD - 1);
+        ringCount--;
+    }
+
+    template <CheckLevel L>
+    void parse() {
+        if (astEnabled && astNodes.empty()) {
+            astNodes.push_back({static_cast<uint8_t>(NodeKind::Program), 0, 0,
+                                static_cast<uint32_t>(source.size()), 0, 0});
+        }
+        if (peekType() != KEYWORD_VAR) {
+            addError(DiagCode::MissingVarKeyword, peek().offset);
+            if (!recoverErrors) return;
+        } else {
+            advance(); // 跳过 'var'
+        }
+
+        parseDefinitionBody<L>();
+        if (!errors.empty() && !recoverErrors) return;
+        if (peekType() != KEYWORD_BEGIN) {
+            addError(DiagCode::MissingBegin, peek().offset);
+            return;
+        }
+        advance(); // 跳过 'begin'
+        parseRealizationBody<L>();
+        if ((errors.empty() || recoverErrors) && peekType() != KEYWORD_END) {
+            addError(DiagCode::MissingProgramEnd, peek().offset);
+        }
+    }
+
+    // 错误恢复同步点：跳过token直到越过下一个 ';'，或停在 begin/end 之前
+    void synchronize() {
+        while (peekType() != END_OF_INPUT) {
+            TokenType type = peekType();
+            if (type == DELIMITER_SEMICOLON) {
+                advance();
+                return;
+            }
+            if (type == KEYWORD_BEGIN || type == KEYWORD_END) return;
+            advance();
+        }
+    }
+
+    template <CheckLevel L>
+    void parseDefinitionBody() {
+        while (peekType() != END_OF_INPUT && peekType() != KEYWORD_BEGIN) {
+            if constexpr (L == CheckLevel::Full) {
+                if (memo != nullptr && tryMemoDeclaration()) continue;
+            }
+            size_t errorsBefore = errors.size();
+            size_t unitStart = bufferedPos;
+            lastDeclared.clear();
+            if (!parseDeclaration<L>()) {
+                if (!recoverErrors) return;
+                synchronize(); // 跳到下一条声明继续收集错误
+            } else if (memo != nullptr && errors.size() == errorsBefore) {
+                if constexpr (L == CheckLevel::Full) {
+                    memoizeDeclaration(unitStart); // 无错单元才进入记忆化
                 }
-                tokenPos++;
-    
-                if (tokenPos >= tokens.size() || (tokens[tokenPos].type != NUMBER && tokens[tokenPos].type != IDENTIFIER)) {
-                    errors.push_back("':=' 后期望数字或标识符，找到: " +
-                                     (tokenPos < tokens.size() ? tokens[tokenPos].value : "无"));
-                    return;
+            }
+        }
+    }
+
+    // 单条变量声明（标识符表 ':' 类型 ';'）；出错时报告并返回false。
+    // LexOnly只验证结构，名单收集与符号表注册整体裁掉
+    template <CheckLevel L>
+    bool parseDeclaration() {
+            if (peekType() == ERROR) {
+            addError(DiagCode::InvalidKeyword, peek().offset, text(peek()));
+            advance();
+            return false; 
+        }
+        if (peekType() != IDENTIFIER) {
+            addError(DiagCode::InvalidLeadingToken, peek().offset, text(peek()));
+            advance();
+            return false;
+        }
+        // 此处已经识别出一个有效的标识符
+        std::string_view varName = text(peek());
+        Token firstNameToken = peek();
+        advance();
+
+        // 声明名单是解析器临时量，放入内存池；元素是指向源缓冲的视图
+        ArenaVector<uint32_t> vars{ArenaAllocator<uint32_t>(arena)};
+        ArenaVector<Token> nameSpans{ArenaAllocator<Token>(arena)}; // 建树模式记录名字区间
+        if constexpr (L == CheckLevel::Full) {
+            if (astEnabled) nameSpans.push_back(firstNameToken);
+            vars.push_back(interner.intern(varName));
+        }
+        (void)firstNameToken;
+        // 检查到逗号，判断后续是否为标识符或更多的组合
+        while (peekType() == DELIMITER_COMMA) {
+            advance();
+            if (peekType() != IDENTIFIER) {
+                addError(DiagCode::ExpectIdentAfterComma, peek().offset);
+                return false;
+            }
+            if (peekType() == ERROR) {
+                addError(DiagCode::InvalidIdentifier, peek().offset, text(peek()));
+                advance();
+                return false;
+            }
+            if constexpr (L == CheckLevel::Full) {
+                if (astEnabled) nameSpans.push_back(peek());
+                vars.push_back(interner.intern(text(peek())));
+            }
+            advance();
+        }
+        if (peekType() == IDENTIFIER) {
+            addError(DiagCode::MissingCommaBetweenIdents, peek().offset);
+            return false;
+        }
+        // 不是标识符，也不是冒号，说明非法
+        if (peekType() != DELIMITER_COLON) {
+            addError(DiagCode::MissingColonAfterVars, peek().offset);
+            return false;
+        }
+        advance();
+
+
+        // 开始判断类型（词法阶段已把类型关键字识别为对应TokenType）
+        if (!isTypeKeyword(peekType())) {
+            addError(DiagCode::ExpectTypeKeyword, peek().offset,
+                     peekType() != END_OF_INPUT ? text(peek()) : std::string_view("无"));
+            return false;
+        }
+        VarType varType = varTypeOf(peekType());
+        advance();
+
+        //前面记录过vars，这里加入符号表（begin end程序主体使用）顺便检查是否重复定义
+        if constexpr (L == CheckLevel::Full) {
+            for (uint32_t id : vars) {
+                if (isDeclared(id)) {
+                    addError(DiagCode::DuplicateVariable, peek().offset, interner.name(id));
+                    return false;
                 }
-                if (tokens[tokenPos].type == IDENTIFIER && !symbolTable.count(tokens[tokenPos].value)) {
-                    errors.push_back("赋值中未定义的变量: " + tokens[tokenPos].value);
-                    return;
+                if (sharedSymbols != nullptr &&
+                    !sharedSymbols->registerDecl(interner.name(id), varType)) {
+                    addError(DiagCode::DuplicateVariableAcrossUnits, peek().offset,
+                             interner.name(id));
+                    return false;
                 }
-                tokenPos++;
-    
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != DELIMITER_SEMICOLON) {
-                    errors.push_back("赋值后缺少 ';'");
-                    return;
+                declare(id, varType);
+                lastDeclared.emplace_back(interner.name(id), varType); // 供记忆化回放
+            }
+        }
+        (void)varType;
+
+        if (peekType() != DELIMITER_SEMICOLON) {
+            addError(DiagCode::MissingSemicolonAfterDecl, peek().offset);
+            return false;
+        }
+        advance();
+
+        if constexpr (L == CheckLevel::Full) {
+            if (astEnabled) {
+                for (const Token& nameToken : nameSpans) {
+                    astAddTopLevel(NodeKind::VarDecl, static_cast<uint8_t>(varType),
+                                   nameToken.offset, nameToken.length);
                 }
-                tokenPos++;
-            }
-            // 处理 while 语句
-            else if (tokens[tokenPos].type == KEYWORD_WHILE) {
-                blockStack.push_back("while");
-                tokenPos++;
-    
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != DELIMITER_LPAREN) {
-                    errors.push_back("while 后缺少 '('");
-                    return;
+            }
+        }
+        return true;
+    }
+
+    // ===== 条件表达式解析 =====
+    // 优先级递降：or < and < 关系运算 < 加减 < 乘除 < 原子。
+    // 取代原先只数括号的跳过循环，使条件里的未定义变量和残缺
+    // 表达式在本趟就报出来，不再漏到下游翻译阶段。
+    template <CheckLevel L>
+    bool parseCondition() { return parseOrExpr<L>(); }
+
+    static bool isRelOp(TokenType type) {
+        return type == OPERATOR_LT || type == OPERATOR_GT || type == OPERATOR_NE ||
+               type == OPERATOR_GE || type == OPERATOR_LE || type == OPERATOR_EQ;
+    }
+
+    template <CheckLevel L>
+    bool parseOrExpr() {
+        if (!parseAndExpr<L>()) return false;
+        while (peekType() == KEYWORD_OR) {
+            advance();
+            if (!parseAndExpr<L>()) return false;
+        }
+        return true;
+    }
+
+    template <CheckLevel L>
+    bool parseAndExpr() {
+        if (!parseRelExpr<L>()) return false;
+        while (peekType() == KEYWORD_AND) {
+            advance();
+            if (!parseRelExpr<L>()) return false;
+        }
+        return true;
+    }
+
+    template <CheckLevel L>
+    bool parseRelExpr() {
+        if (!parseAddExpr<L>()) return false;
+        if (isRelOp(peekType())) {
+            advance();
+            return parseAddExpr<L>();
+        }
+        return true;
+    }
+
+    template <CheckLevel L>
+    bool parseAddExpr() {
+        if (!parseMulExpr<L>()) return false;
+        while (peekType() == OPERATOR_PLUS || peekType() == OPERATOR_MINUS) {
+            advance();
+            if (!parseMulExpr<L>()) return false;
+        }
+        return true;
+    }
+
+    template <CheckLevel L>
+    bool parseMulExpr() {
+        if (!parsePrimary<L>()) return false;
+        while (peekType() == OPERATOR_MULTIPLY || peekType() == OPERATOR_DIVIDE) {
+            advance();
+            if (!parsePrimary<L>()) return false;
+        }
+        return true;
+    }
+
+    // 原子：数字、已声明的标识符、或带括号的子表达式
+    template <CheckLevel L>
+    bool parsePrimary() {
+        if (peekType() == NUMBER) {
+            advance();
+            return true;
+        }
+        if (peekType() == IDENTIFIER) {
+            if constexpr (L == CheckLevel::Full) {
+                if (!isDeclared(interner.intern(text(peek())))) {
+                    addError(DiagCode::UndefinedVarInCondition, peek().offset, text(peek()));
+                    return false;
                 }
-                tokenPos++;
-    
-                // 条件表达式
-                int parenCount = 1;
-                while (tokenPos < tokens.size() && parenCount > 0) {
-                    if (tokens[tokenPos].type == DELIMITER_LPAREN) parenCount++;
-                    else if (tokens[tokenPos].type == DELIMITER_RPAREN) parenCount--;
-                    tokenPos++;
+            }
+            advance();
+            return true;
+        }
+        if (peekType() == DELIMITER_LPAREN) {
+            advance();
+            if (!parseOrExpr<L>()) return false;
+            if (peekType() != DELIMITER_RPAREN) {
+                addError(DiagCode::UnclosedParenInCondition, peek().offset);
+                return false;
+            }
+            advance();
+            return true;
+        }
+        addError(DiagCode::ExpectOperandInCondition, peek().offset,
+                 peekType() != END_OF_INPUT ? text(peek()) : std::string_view("无"));
+        return false;
+    }
+
+    template <CheckLevel L>
+    void parseRealizationBody() {
+        ArenaVector<std::string_view> blockStack{ArenaAllocator<std::string_view>(arena)}; // 用于跟踪 begin, while, if 等结构的配对
+
+        while (peekType() != END_OF_INPUT && peekType() != KEYWORD_END) {
+            if constexpr (L == CheckLevel::Full) {
+                if (memo != nullptr && peekType() == IDENTIFIER && tryMemoStatement()) continue;
+            }
+            size_t errorsBefore = errors.size();
+            size_t unitStart = bufferedPos;
+            bool wasAssignment = peekType() == IDENTIFIER;
+            if (!parseStatement<L>(blockStack)) {
+                if (!recoverErrors) return;
+                synchronize(); // 跳到下一条语句继续收集错误
+            } else if (memo != nullptr && wasAssignment && errors.size() == errorsBefore) {
+                if constexpr (L == CheckLevel::Full) {
+                    memoizeStatement(unitStart); // 只记忆化无错的赋值语句
                 }
-                if (parenCount > 0) {
-                    errors.push_back("while 条件中括号未闭合");
-                    return;
+            }
+        }
+
+        // 检查是否有未闭合的块
+        if (!blockStack.empty()) {
+            addError(DiagCode::MissingEndForBlock, peek().offset, blockStack.back());
+            return;
+        }
+    }
+
+    // 单条语句（赋值/while/if/begin/end/else）；出错时报告并返回false。
+    // LexOnly保留全部结构配对检查，裁掉符号表探测与类型/范围检查
+    template <CheckLevel L>
+    bool parseStatement(ArenaVector<std::string_view>& blockStack) {
+            if (peekType() == ERROR) {
+            addError(DiagCode::InvalidTokenInBody, peek().offset, text(peek()));
+            advance();
+            return false;
+        }
+
+        // 赋值语句
+        if (peekType() == IDENTIFIER) {
+            std::string_view varName = text(peek());
+            Token lhsToken = peek();
+            VarType target = VarType::Integer;
+            if constexpr (L == CheckLevel::Full) {
+                uint32_t lhsId = interner.intern(varName);
+                if (!isDeclared(lhsId)) {
+                    addError(DiagCode::UndefinedVariable, peek().offset, varName);
+                    return false;
                 }
-    
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != KEYWORD_DO) {
-                    errors.push_back("while 条件后缺少 'do'");
-                    return;
+                target = typeOf(lhsId);
+            }
+            advance();
+
+            if (peekType() != OPERATOR_ASSIGN) {
+                addError(DiagCode::MissingAssignOperator, peek().offset, varName);
+                return false;
+            }
+            advance();
+
+            if ((peekType() != NUMBER && peekType() != IDENTIFIER)) {
+                addError(DiagCode::ExpectValueAfterAssign, peek().offset,
+                         peekType() != END_OF_INPUT ? text(peek()) : std::string_view("无"));
+                return false;
+            }
+            if constexpr (L == CheckLevel::Full) {
+                if (peekType() == IDENTIFIER) {
+                    uint32_t rhsId = interner.intern(text(peek()));
+                    if (!isDeclared(rhsId)) {
+                        addError(DiagCode::UndefinedVarInAssignment, peek().offset,
+                                 text(peek()));
+                        return false;
+                    }
+                    // 类型兼容检查：按拓宽格判定，类型错误在这一遍就暴露，
+                    // 不留给下游生成的C++编译时再失败
+                    if (!assignable(target, typeOf(rhsId))) {
+                        addError(DiagCode::AssignTypeMismatch, peek().offset, varName);
+                        return false;
+                    }
                 }
-                tokenPos++;
-            }
-            // 处理 if 语句
-            else if (tokens[tokenPos].type == KEYWORD_IF) {
-                blockStack.push_back("if");
-                tokenPos++;
-    
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != DELIMITER_LPAREN) {
-                    errors.push_back("if 后缺少 '('");
-                    return;
+            }
+            Token rhsToken = peek();
+            if constexpr (L == CheckLevel::Full) {
+                // 数字字面量就地折叠成u64并对照目标类型的范围；数字不可
+                // 赋给bool（bool := 12345 曾一路漏到下游编译）
+                if (peekType() == NUMBER) {
+                    if (target == VarType::Bool) {
+                        addError(DiagCode::AssignTypeMismatch, peek().offset, varName);
+                        return false;
+                    }
+                    uint64_t value = 0;
+                    if (!foldDigits(text(peek()), value) ||
+                        value > maxLiteralOf(target)) {
+                        addError(DiagCode::NumberOutOfRange, peek().offset, text(peek()));
+                        return false;
+                    }
                 }
-                tokenPos++;
-    
-                // 条件表达式
-                int parenCount = 1;
-                while (tokenPos < tokens.size() && parenCount > 0) {
-                    if (tokens[tokenPos].type == DELIMITER_LPAREN) parenCount++;
-                    else if (tokens[tokenPos].type == DELIMITER_RPAREN) parenCount--;
-                    tokenPos++;
+            }
+            (void)target;
+            advance();
+
+            if (peekType() != DELIMITER_SEMICOLON) {
+                addError(DiagCode::MissingSemicolonAfterAssign, peek().offset);
+                return false;
+            }
+            advance();
+
+            if (L == CheckLevel::Full && astEnabled) {
+                uint32_t assign = astAddTopLevel(
+                    NodeKind::Assign, 0, lhsToken.offset,
+                    rhsToken.offset + rhsToken.length - lhsToken.offset);
+                uint32_t lhs = static_cast<uint32_t>(astNodes.size());
+                astNodes.push_back({static_cast<uint8_t>(NodeKind::VarRef), 0,
+                                    lhsToken.offset, lhsToken.length, 0, 0});
+                uint32_t rhs = static_cast<uint32_t>(astNodes.size());
+                astNodes.push_back(
+                    {static_cast<uint8_t>(rhsToken.type == NUMBER
+                                              ? NodeKind::NumberLit
+                                              : NodeKind::VarRef),
+                     0, rhsToken.offset, rhsToken.length, 0, 0});
+                astNodes[assign].firstChild = lhs;
+                astNodes[lhs].nextSibling = rhs;
+            }
+        }
+        // 处理 while 语句
+        else if (peekType() == KEYWORD_WHILE) {
+            blockStack.push_back("while");
+            advance();
+
+            if (peekType() != DELIMITER_LPAREN) {
+                addError(DiagCode::MissingParenAfterWhile, peek().offset);
+                return false;
+            }
+            advance();
+
+            // 条件表达式：按优先级真正解析，未定义变量就地报错
+            if (!parseCondition<L>()) return false;
+            if (peekType() != DELIMITER_RPAREN) {
+                addError(DiagCode::UnclosedParenInWhile, peek().offset);
+                return false;
+            }
+            advance();
+
+            if (peekType() != KEYWORD_DO) {
+                addError(DiagCode::MissingDoAfterWhile, peek().offset);
+                return false;
+            }
+            advance();
+        }
+        // 处理 if 语句
+        else if (peekType() == KEYWORD_IF) {
+            blockStack.push_back("if");
+            advance();
+
+            if (peekType() != DELIMITER_LPAREN) {
+                addError(DiagCode::MissingParenAfterIf, peek().offset);
+                return false;
+            }
+            advance();
+
+            // 条件表达式：按优先级真正解析，未定义变量就地报错
+            if (!parseCondition<L>()) return false;
+            if (peekType() != DELIMITER_RPAREN) {
+                addError(DiagCode::UnclosedParenInIf, peek().offset);
+                return false;
+            }
+            advance();
+
+            if (peekType() != KEYWORD_THEN) {
+                addError(DiagCode::MissingThenAfterIf, peek().offset);
+                return false;
+            }
+            advance();
+        }
+        // 处理 begin
+        else if (peekType() == KEYWORD_BEGIN) {
+            blockStack.push_back("begin");
+            advance();
+        }
+        // 处理 end（匹配 while, if 或 begin）
+        else if (peekType() == KEYWORD_END) {
+            if (blockStack.empty()) {
+                addError(DiagCode::ExtraEnd, peek().offset);
+                return false;
+            }
+            std::string_view lastBlock = blockStack.back();
+            blockStack.pop_back();
+            advance();
+
+            // 检查 end 后的分号（仅在嵌套块中需要）
+            if (!blockStack.empty() && (peekType() != DELIMITER_SEMICOLON)) {
+                addError(DiagCode::MissingSemicolonAfterEnd, peek().offset, lastBlock);
+                return false;
+            }
+            if (peekType() == DELIMITER_SEMICOLON) {
+                advance();
+            }
+        }
+        // 处理 else
+        else if (peekType() == KEYWORD_ELSE) {
+            if (blockStack.empty() || blockStack.back() != "if") {
+                addError(DiagCode::ElseWithoutIf, peek().offset);
+                return false;
+            }
+            advance();
+        }
+        else {
+            addError(DiagCode::UnexpectedToken, peek().offset, text(peek()));
+            advance();
+            return false;
+        }
+        return true;
+    }
+
+};
+
+// ===== 增量重分析会话 =====
+// 编辑器集成的入口：保留上一轮的token流和记忆化结果，一次编辑
+// （字节区间+替换文本）只重词法受损区域——损伤点之前的token原样
+// 保留，之后的token一旦词法器与旧流重新对齐就整体平移复用；解析
+// 则借助 Analyzer 的记忆化，只有内容变化的声明/赋值语句被重新
+// 检查。声明区变化会推进epoch，使语句缓存整体失效（保守但正确）。
+class IncrementalSession {
+public:
+    explicit IncrementalSession(std::string initial) : source(std::move(initial)) {
+        fullLex();
+        runAnalysis();
+    }
+
+    // 应用一次编辑并重新分析，返回当前全部诊断
+    const std::vector<std::string>& update(size_t offset, size_t removedLen,
+                                           std::string_view replacement) {
+        source.replace(offset, removedLen, replacement);
+        incrementalRelex(offset, removedLen, replacement.size());
+        runAnalysis();
+        return diags;
+    }
+
+    const std::vector<std::string>& diagnostics() const { return diags; }
+    size_t tokenCount() const { return tokens.size(); }
+
+private:
+    std::string source;                 // 当前源内容（编辑就地拼接）
+    std::vector<Token> tokens;          // 跨轮次维护的token流
+    Analyzer::MemoStore memo;           // 无错单元的记忆化存储
+    uint64_t declEpoch = 0;             // 声明区内容的代数
+    uint64_t lastDeclHash = 0;
+    std::vector<std::string> diags;     // 最近一轮的诊断
+
+    void fullLex() {
+        tokens.clear();
+        LexCursor cursor{source, 0, source.length()};
+        Token token;
+        while ((token = cursor.next()).type != END_OF_INPUT) {
+            tokens.push_back(token);
+        }
+    }
+
+    // 增量重词法：只有 [editStart, editStart+insertedLen) 附近需要重扫
+    void incrementalRelex(size_t editStart, size_t removedLen, size_t insertedLen) {
+        const long delta = static_cast<long>(insertedLen) - static_cast<long>(removedLen);
+        std::vector<Token> old = std::move(tokens);
+        tokens.clear();
+
+        // 严格结束于编辑点之前的token保留；再回退一个，防止编辑把
+        // 前一个token的尾部粘连进来（如 ':' 后插入 '='）
+        size_t keep = 0;
+        while (keep < old.size() &&
+               old[keep].offset + old[keep].length < editStart) {
+            keep++;
+        }
+        if (keep > 0) keep--;
+        tokens.assign(old.begin(), old.begin() + keep);
+
+        // 旧流中完全位于编辑区之后的部分是平移复用的候选
+        size_t oldIdx = keep;
+        while (oldIdx < old.size() && old[oldIdx].offset < editStart + removedLen) {
+            oldIdx++;
+        }
+
+        size_t resume = keep > 0 ? tokens.back().offset + tokens.back().length : 0;
+        LexCursor cursor{source, resume, source.length()};
+        Token token;
+        while ((token = cursor.next()).type != END_OF_INPUT) {
+            // 越过编辑区后尝试与旧流对齐：偏移平移后类型、长度都一致
+            // 即视为重新同步，剩余旧token整体平移接入
+            if (static_cast<long>(token.offset) >= static_cast<long>(editStart + insertedLen)) {
+                while (oldIdx < old.size() &&
+                       static_cast<long>(old[oldIdx].offset) + delta <
+                           static_cast<long>(token.offset)) {
+                    oldIdx++;
                 }
-                if (parenCount > 0) {
-                    errors.push_back("if 条件中括号未闭合");
+                if (oldIdx < old.size() &&
+                    static_cast<long>(old[oldIdx].offset) + delta ==
+                        static_cast<long>(token.offset) &&
+                    old[oldIdx].type == token.type && old[oldIdx].length == token.length) {
+                    for (size_t i = oldIdx; i < old.size(); i++) {
+                        Token shifted = old[i];
+                        shifted.offset = static_cast<uint32_t>(
+                            static_cast<long>(shifted.offset) + delta);
+                        tokens.push_back(shifted);
+                    }
                     return;
                 }
-    
-                if (tokenPos >= tokens.size() || tokens[tokenPos].type != KEYWORD_THEN) {
-                    errors.push_back("if 条件后缺少 'then'");
-                    return;
+            }
+            tokens.push_back(token);
+        }
+    }
+
+    // 声明区（第一个begin之前）的内容哈希，变化则推进epoch
+    uint64_t declSectionHash() const {
+        size_t end = 0;
+        while (end < tokens.size() && tokens[end].type != KEYWORD_BEGIN) end++;
+        return hashTokenSpan(source, tokens.data(), end);
+    }
+
+    void runAnalysis() {
+        uint64_t declHash = declSectionHash();
+        if (declHash != lastDeclHash) {
+            declEpoch++;
+            lastDeclHash = declHash;
+        }
+        Analyzer analyzer(std::string_view(source), Analyzer::ViewInput{});
+        analyzer.adoptTokens(tokens);
+        analyzer.enableErrorRecovery(); // 编辑器要看到全部诊断
+        analyzer.attachMemo(&memo, declEpoch);
+        analyzer.analyzeQuiet();
+        diags = analyzer.copyErrors();
+    }
+};
+
+// ===== 结果缓存 =====
+// 夜间批跑里九成五的文件与前夜逐字节相同，却每次都重新分析。
+// 这里按内容哈希持久化分析报告：命中直接取回报告、完全跳过分析。
+// 键只含文件内容，缓存文件应按运行配置分开（不同输出选项不混用）
+namespace cache {
+
+inline uint64_t hashBytes(std::string_view bytes) {
+    uint64_t h = 14695981039346656037ull;
+    for (char c : bytes) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+inline constexpr char INDEX_MAGIC[4] = {'P', 'R', 'C', '1'};
+
+// 线程安全的哈希->报告存储；批跑结束后dirty才回写
+class ResultCache {
+public:
+    bool lookup(uint64_t hash, std::string& report) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = map.find(hash);
+        if (it == map.end()) return false;
+        report = it->second;
+        return true;
+    }
+
+    void insert(uint64_t hash, const std::string& report) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (map.emplace(hash, report).second) dirty = true;
+    }
+
+    // 磁盘索引格式：魔数 + 逐条 {u64哈希, u32长度, 报告字节}
+    void load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return;
+        char magic[4];
+        if (!in.read(magic, 4) || std::memcmp(magic, INDEX_MAGIC, 4) != 0) return;
+        uint64_t hash;
+        uint32_t length;
+        while (in.read(reinterpret_cast<char*>(&hash), sizeof(hash)) &&
+               in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+            std::string report(length, '\0');
+            if (!in.read(report.data(), length)) break;
+            map.emplace(hash, std::move(report));
+        }
+    }
+
+    void save(const std::string& path) const {
+        if (!dirty) return;
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return;
+        out.write(INDEX_MAGIC, 4);
+        for (const auto& [hash, report] : map) {
+            uint32_t length = static_cast<uint32_t>(report.size());
+            out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(report.data(), length);
+        }
+    }
+
+private:
+    std::unordered_map<uint64_t, std::string> map;
+    mutable std::mutex mutex;
+    bool dirty = false;
+};
+
+} // namespace cache
+
+// ===== 批处理驱动 =====
+// 一次校验成千上万个生成的源文件：固定工作线程池从共享的原子任务
+// 游标领取下一个文件（先完成者先领取，大文件不会拖住整批的尾巴），
+// 每个文件得到独立的结果对象，输出顺序与输入顺序一致。
+namespace batch {
+
+struct FileResult {
+    std::string path;    // 输入文件
+    std::string report;  // 格式化的分析结果
+};
+
+// 缓存里的NDJSON载荷不带file字段——按内容寻址的缓存若存了路径，
+// 字节相同的另一个文件命中时会回放别人的路径。输出前按行拼回当前路径
+inline std::string ndjsonWithFile(const std::string& body, const std::string& path) {
+    std::string prefix = "{\"file\":\"";
+    Analyzer::jsonEscape(path, prefix);
+    prefix += "\",";
+    std::string out;
+    out.reserve(body.size() + prefix.size() * 4);
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t nl = body.find('\n', pos);
+        if (nl == std::string::npos) nl = body.size() - 1;
+        out += prefix;
+        out.append(body, pos + 1, nl - pos); // 跳过行首'{'，连同换行拷出
+        pos = nl + 1;
+    }
+    return out;
+}
+
+inline std::vector<FileResult> run(const std::vector<std::string>& paths,
+                                   unsigned threadCount = 0,
+                                   bool recoverErrors = false,
+                                   bool emitStats = false,
+                                   bool emitNdjson = false,
+                                   bool sharedSymbols = false,
+                                   bool locate = false,
+                                   cache::ResultCache* resultCache = nullptr,
+                                   bool preScreen = false) {
+    std::vector<FileResult> results(paths.size());
+    std::atomic<size_t> nextTask{0};
+    SharedSymbolTable sharedTable; // sharedSymbols时各单元共享声明命名空间
+    // 共享符号表下结果依赖整批输入而非单文件内容：缓存命中会跳过
+    // 分析、声明不再登记到共享表，跨单元重名检测被悄悄关掉。直接停用缓存
+    if (sharedSymbols) { resultCache = nullptr; }
+
+    unsigned workers = threadCount ? threadCount : std::thread::hardware_concurrency();
+    if (workers < 1) workers = 1;
+    if (workers > paths.size()) workers = static_cast<unsigned>(paths.size());
+
+    auto worker = [&] {
+        // 每线程一个Analyzer，跨文件reset复用池块与符号表容量
+        Analyzer analyzer{std::string()};
+        size_t i;
+        while ((i = nextTask.fetch_add(1, std::memory_order_relaxed)) < paths.size()) {
+            analyzer.reset(paths[i], Analyzer::InputMode::File);
+            // 命中结果缓存则跳过整个分析。读取失败的文件一律绕过
+            // 缓存：空源会让所有坏文件共享同一个键，取回的报告还
+            // 嵌着别的文件的路径
+            uint64_t contentHash = 0;
+            bool cacheUsable = resultCache != nullptr && !analyzer.loadFailed();
+            if (cacheUsable) {
+                contentHash = cache::hashBytes(analyzer.sourceView());
+                std::string cached;
+                if (resultCache->lookup(contentHash, cached)) {
+                    results[i] = {paths[i], emitNdjson
+                                                ? ndjsonWithFile(cached, paths[i])
+                                                : std::move(cached)};
+                    continue;
                 }
-                tokenPos++;
             }
-            // 处理 begin
-            else if (tokens[tokenPos].type == KEYWORD_BEGIN) {
-                blockStack.push_back("begin");
-                tokenPos++;
+            if (sharedSymbols) {
+                analyzer.attachSharedSymbols(&sharedTable);
             }
-            // 处理 end（匹配 while, if 或 begin）
-            else if (tokens[tokenPos].type == KEYWORD_END) {
-                if (blockStack.empty()) {
-                    errors.push_back("多余的 'end'");
-                    return;
+            if (locate) {
+                analyzer.enableLocations();
+            }
+            if (recoverErrors) {
+                analyzer.enableErrorRecovery();
+            }
+            if (emitStats) {
+                analyzer.enableStats();
+            }
+            if (preScreen) {
+                analyzer.analyzeQuiet<CheckLevel::LexOnly>();
+            } else {
+                analyzer.analyzeQuiet();
+            }
+            // 入缓存的载荷既不含file字段也不含统计：路径因文件而异，
+            // 计时因运行而异，都不是文件内容的函数
+            std::string body = emitNdjson ? analyzer.diagnosticsNdjson()
+                                          : analyzer.formatReport();
+            if (cacheUsable) {
+                resultCache->insert(contentHash, body);
+            }
+            std::string report = emitNdjson ? ndjsonWithFile(body, paths[i])
+                                            : std::move(body);
+            if (emitStats) {
+                report += analyzer.statsJson();
+                report += "\n";
+            }
+            results[i] = {paths[i], std::move(report)};
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (unsigned t = 0; t < workers; t++) threads.emplace_back(worker);
+    for (auto& t : threads) t.join();
+    return results;
+}
+
+// ===== 流水线批处理 =====
+// run()的工作线程读完一个文件才开始算，读盘时核闲、计算时盘闲。
+// 这里拆成两级流水：一个预读线程按输入序把文件读进有界队列
+// （容量为工作线程数的两倍，即每个工作线程双缓冲），分析线程只
+// 消费已就位的缓冲；读下一批与算当前批重叠进行
+
+struct Loaded {
+    size_t index = 0;  // 在paths中的下标
+    std::string data;  // 文件内容
+    bool ok = false;   // 读取是否成功
+};
+
+// 有界阻塞队列：满则预读阻塞，空则消费阻塞，close后消费方逐渐退出
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(Loaded&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(Loaded& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<Loaded> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+inline std::vector<FileResult> runPipelined(const std::vector<std::string>& paths,
+                                            unsigned threadCount = 0,
+                                            bool recoverErrors = false,
+                                            bool emitStats = false,
+                                            bool emitNdjson = false,
+                                            bool sharedSymbols = false,
+                                            bool locate = false,
+                                            cache::ResultCache* resultCache = nullptr,
+                                            bool preScreen = false) {
+    std::vector<FileResult> results(paths.size());
+    SharedSymbolTable sharedTable;
+    // 同run()：共享符号表与按内容缓存不相容，停用缓存
+    if (sharedSymbols) { resultCache = nullptr; }
+
+    unsigned workers = threadCount ? threadCount : std::thread::hardware_concurrency();
+    if (workers < 1) workers = 1;
+    if (workers > paths.size()) workers = static_cast<unsigned>(paths.size());
+
+    BoundedQueue queue(workers * 2);
+
+    // 预读级：顺序发起读，填满双缓冲即阻塞等消费
+    std::thread reader([&] {
+        for (size_t i = 0; i < paths.size(); i++) {
+            Loaded item;
+            item.index = i;
+            std::ifstream in(paths[i], std::ios::binary);
+            if (in) {
+                item.data.assign((std::istreambuf_iterator<char>(in)),
+                                 std::istreambuf_iterator<char>());
+                item.ok = true;
+            }
+            queue.push(std::move(item));
+        }
+        queue.close();
+    });
+
+    auto worker = [&] {
+        Analyzer analyzer{std::string()};
+        Loaded item;
+        while (queue.pop(item)) {
+            size_t i = item.index;
+            uint64_t contentHash = 0;
+            bool cacheUsable = resultCache != nullptr && item.ok;
+            if (cacheUsable) {
+                contentHash = cache::hashBytes(item.data);
+                std::string cached;
+                if (resultCache->lookup(contentHash, cached)) {
+                    results[i] = {paths[i], emitNdjson
+                                                ? ndjsonWithFile(cached, paths[i])
+                                                : std::move(cached)};
+                    continue;
                 }
-                std::string lastBlock = blockStack.back();
-                blockStack.pop_back();
-                tokenPos++;
-    
-                // 检查 end 后的分号（仅在嵌套块中需要）
-                if (!blockStack.empty() && (tokenPos >= tokens.size() || tokens[tokenPos].type != DELIMITER_SEMICOLON)) {
-                    errors.push_back(lastBlock + " 的 'end' 后缺少 ';'");
+            }
+            if (item.ok) {
+                analyzer.reset(std::move(item.data));
+            } else {
+                // 预读失败的文件重走文件加载，让 CannotOpenFile 诊断和
+                // 其余错误走同一条报告路径（--ndjson 下输出同样是JSON行）
+                analyzer.reset(paths[i], Analyzer::InputMode::File);
+            }
+            if (sharedSymbols) analyzer.attachSharedSymbols(&sharedTable);
+            if (locate) analyzer.enableLocations();
+            if (recoverErrors) analyzer.enableErrorRecovery();
+            if (emitStats) analyzer.enableStats();
+            if (preScreen) {
+                analyzer.analyzeQuiet<CheckLevel::LexOnly>();
+            } else {
+                analyzer.analyzeQuiet();
+            }
+            // 同run()：缓存载荷不含file字段与统计
+            std::string body = emitNdjson ? analyzer.diagnosticsNdjson()
+                                          : analyzer.formatReport();
+            if (cacheUsable) {
+                resultCache->insert(contentHash, body);
+            }
+            std::string report = emitNdjson ? ndjsonWithFile(body, paths[i])
+                                            : std::move(body);
+            if (emitStats) {
+                report += analyzer.statsJson();
+                report += "\n";
+            }
+            results[i] = {paths[i], std::move(report)};
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers);
+    for (unsigned t = 0; t < workers; t++) threads.emplace_back(worker);
+    for (auto& t : threads) t.join();
+    reader.join();
+    return results;
+}
+
+} // namespace batch
+
+// ===== 基准测试 =====
+// 仓库此前没有任何基准：main() 只跑十个小字符串。这里内置一个语料
+// 生成器和吞吐量测量，让对 Analyzer 的每次性能改动都能对着固定语料
+// 比数字，而不是凭感觉。语料生成是确定性的（固定种子），同参数下
+// 各次运行比较的是同一份输入。
+namespace bench {
+
+// 生成指定目标大小的合法Pascal程序。
+//   identLen    标识符长度（影响词法内层循环的密度）
+//   declPercent 声明区占总字节数的大致百分比（声明/语句混合比）
+inline std::string generate(size_t targetBytes, size_t identLen,
+                            unsigned declPercent, uint32_t seed = 42) {
+    std::mt19937 rng(seed);
+    std::string out;
+    out.reserve(targetBytes + 64);
+
+    // 标识符按序号编码并用'0'补齐到指定长度；编码部分只含字母，
+    // 补齐部分只含数字，不同序号不可能补齐成同名
+    auto makeName = [identLen](size_t index) {
+        std::string name = "v";
+        do {
+            name += static_cast<char>('a' + index % 26);
+            index /= 26;
+        } while (index > 0);
+        while (name.size() < identLen) name += '0';
+        return name;
+    };
+
+    size_t declBudget = targetBytes * declPercent / 100;
+    out += "Var ";
+    size_t varCount = 0;
+    static const char* types[] = {"integer", "bool", "longint"};
+    while (out.size() < declBudget || varCount == 0) {
+        if (varCount > 0) out += ';';
+        out += makeName(varCount);
+        out += ':';
+        out += types[varCount % 3];
+        varCount++;
+    }
+    out += ";Begin ";
+
+    // 语句区：已声明变量之间的赋值与数字字面量赋值交替出现；
+    // bool变量只自赋值（数字不可赋给bool）
+    std::uniform_int_distribution<size_t> pickVar(0, varCount - 1);
+    std::uniform_int_distribution<int> pickNum(0, 99999);
+    size_t stmt = 0;
+    while (out.size() < targetBytes) {
+        size_t lhs = pickVar(rng);
+        out += makeName(lhs);
+        out += ":=";
+        if (stmt % 2 == 0 || lhs % 3 == 1) {
+            // 同类型变量才合法：自赋值保证类型一致
+            out += makeName(lhs);
+        } else {
+            out += std::to_string(pickNum(rng));
+        }
+        out += ';';
+        stmt++;
+    }
+    out += "End";
+    return out;
+}
+
+// 纯词法吞吐：跑空整个token流，返回token数
+inline uint64_t tokenizeOnce(std::string_view src) {
+    LexCursor cursor{src, 0, src.length()};
+    uint64_t count = 0;
+    while (cursor.next().type != END_OF_INPUT) count++;
+    return count;
+}
+
+// 最优轮耗时（秒）：取3轮中最快的一轮，排除偶发抖动
+template <typename F>
+inline double bestOf(F&& body) {
+    double best = 1e30;
+    for (int round = 0; round < 3; round++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+inline void run(const std::vector<size_t>& sizesKB, size_t identLen, unsigned declPercent) {
+    for (size_t kb : sizesKB) {
+        std::string corpus = generate(kb * 1024, identLen, declPercent);
+        double mb = static_cast<double>(corpus.size()) / (1024.0 * 1024.0);
+        uint64_t tokens = tokenizeOnce(corpus);
+
+        double lexSec = bestOf([&] { tokenizeOnce(corpus); });
+
+        uint64_t allocsBefore = 0, allocBytesBefore = 0;
+        size_t arenaBytes = 0, arenaBlocks = 0;
+        double parseSec = bestOf([&] {
+            allocsBefore = g_heapAllocCount.load(std::memory_order_relaxed);
+            allocBytesBefore = g_heapAllocBytes.load(std::memory_order_relaxed);
+            Analyzer analyzer(std::string_view(corpus), Analyzer::ViewInput{});
+            analyzer.analyzeQuiet();
+            arenaBytes = analyzer.arenaBytesReserved();
+            arenaBlocks = analyzer.arenaBlockCount();
+        });
+        uint64_t allocs = g_heapAllocCount.load(std::memory_order_relaxed) - allocsBefore;
+        uint64_t allocBytes = g_heapAllocBytes.load(std::memory_order_relaxed) - allocBytesBefore;
+
+        std::printf("语料 %zuKB (标识符%zu字符, 声明占%u%%): %llu tokens\n",
+                    kb, identLen, declPercent, static_cast<unsigned long long>(tokens));
+        std::printf("  词法      %8.1f MB/s  %8.1f Mtok/s\n",
+                    mb / lexSec, static_cast<double>(tokens) / 1e6 / lexSec);
+        std::printf("  完整分析  %8.1f MB/s  %8.1f Mtok/s  堆分配%llu次/%lluB  池%zu块/%zuB\n",
+                    mb / parseSec, static_cast<double>(tokens) / 1e6 / parseSec,
+                    static_cast<unsigned long long>(allocs),
+                    static_cast<unsigned long long>(allocBytes), arenaBlocks, arenaBytes);
+    }
+}
+
+} // namespace bench
+
+// ===== 压力测试 =====
+// main()里十个手写串覆盖不了对抗性输入。这里生成三类已知的风险
+// 结构——begin深嵌套（压blockStack与synchronize）、超长逗号声明表
+// （压parseDeclaration的名单循环）、未闭合括号洪泛（压条件解析的
+// 递归下降）——按 n/2n/4n 三档测时，按字节归一后的耗时比超过阈值
+// 即判超线性回归，连同各档的统计JSON一起报出并以非零码退出
+namespace stress {
+
+// begin深嵌套；恢复模式下解析器要一路收集未配对错误
+inline std::string genNesting(size_t depth) {
+    std::string out = "Var a:integer;Begin ";
+    for (size_t i = 0; i < depth; i++) out += "Begin ";
+    out += "a:=1;";
+    for (size_t i = 0; i < depth; i++) out += "End;";
+    out += "End";
+    return out;
+}
+
+// 单条声明里的超长标识符名单
+inline std::string genFanout(size_t count) {
+    std::string out = "Var ";
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) out += ',';
+        out += 'a';
+        out += std::to_string(i);
+    }
+    out += ":integer;Begin a0:=1;End";
+    return out;
+}
+
+// 未闭合括号洪泛进条件解析；深度受限于递归下降的栈
+inline std::string genParenFlood(size_t depth) {
+    std::string out = "Var a:integer;Begin While";
+    out.append(depth, '(');
+    out += "a<1 Do a:=1;End";
+    return out;
+}
+
+// 恢复模式+统计模式下的最优轮耗时；profile带回该档的统计JSON
+inline double timeAnalyze(const std::string& program, std::string& profile) {
+    double best = 1e30;
+    for (int round = 0; round < 3; round++) {
+        Analyzer analyzer(std::string_view(program), Analyzer::ViewInput{});
+        analyzer.enableErrorRecovery();
+        analyzer.enableStats();
+        auto start = std::chrono::steady_clock::now();
+        analyzer.analyzeQuiet();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) {
+            best = elapsed.count();
+            profile = analyzer.statsJson();
+        }
+    }
+    return best;
+}
+
+inline int run() {
+    struct Case {
+        const char* name;
+        std::string (*gen)(size_t);
+        size_t base;
+    };
+    // 括号档位刻意小：条件解析按括号深度递归，档位过大先撞栈
+    const Case cases[] = {
+        {"begin嵌套", genNesting, 1 << 14},
+        {"声明扇出", genFanout, 1 << 15},
+        {"括号洪泛", genParenFlood, 1 << 10},
+    };
+    // 按字节归一的耗时比上限；线性≈1，留噪声余量
+    constexpr double LINEAR_SLACK = 2.5;
+
+    bool failed = false;
+    for (const Case& testCase : cases) {
+        double perByte[3];
+        std::string profiles[3];
+        std::printf("%s:\n", testCase.name);
+        for (int step = 0; step < 3; step++) {
+            size_t n = testCase.base << step;
+            std::string program = testCase.gen(n);
+            double seconds = timeAnalyze(program, profiles[step]);
+            perByte[step] = seconds / static_cast<double>(program.size());
+            std::printf("  n=%-8zu %9.3f ms  %8.1f MB/s\n", n, seconds * 1000.0,
+                        static_cast<double>(program.size()) / (1024.0 * 1024.0) / seconds);
+        }
+        double worst = std::max(perByte[1] / perByte[0], perByte[2] / perByte[0]);
+        if (worst > LINEAR_SLACK) {
+            failed = true;
+            std::printf("  超线性回归：按字节归一的耗时比 %.2f 超过阈值 %.2f\n",
+                        worst, LINEAR_SLACK);
+            for (int step = 0; step < 3; step++) {
+                std::printf("  档位%d统计: %s\n", step, profiles[step].c_str());
+            }
+        }
+    }
+    std::printf(failed ? "压力测试：发现回归\n" : "压力测试：全部通过\n");
+    return failed ? 1 : 0;
+}
+
+} // namespace stress
+
+int main(int argc, char* argv[]) {
+    // 传入文件/目录路径时走文件模式（mmap），否则跑内置测试用例
+    // -j[N]:    大文件用N个线程并行分块词法（缺省为硬件核数）
+    // --batch:  多文件由工作线程池并发分析，目录参数展开为其中的普通文件
+    if (argc > 1) {
+        // --demo-incremental: 演示增量会话（编辑后只重分析受影响单元）
+        if (argc == 2 && std::string(argv[1]) == "--demo-incremental") {
+            IncrementalSession session("Var i,j:integer;Begin i:=0;j:=1;End");
+            auto report = [](const std::vector<std::string>& diags) {
+                if (diags.empty()) {
+                    std::cout << "分析成功：未发现错误。\n";
                     return;
                 }
-                if (tokenPos < tokens.size() && tokens[tokenPos].type == DELIMITER_SEMICOLON) {
-                    tokenPos++;
+                for (const auto& diag : diags) std::cout << "- " << diag << "\n";
+            };
+            std::cout << "初始: ";
+            report(session.diagnostics());
+            std::cout << "编辑 j:=1 -> j:=k: ";
+            report(session.update(30, 1, "k"));
+            std::cout << "编辑 j:=k -> j:=22: ";
+            report(session.update(30, 1, "22"));
+            return 0;
+        }
+
+        // --dump-ast <源>: 建树模式分析并前序打印扁平AST
+        if (argc == 3 && std::string(argv[1]) == "--dump-ast") {
+            Analyzer analyzer(argv[2], Analyzer::InputMode::File);
+            analyzer.enableAstBuild();
+            analyzer.analyzeQuiet();
+            std::cout << analyzer.formatReport() << analyzer.dumpAst();
+            return 0;
+        }
+
+        // --translate <源> [输出]: 干净解析后产出C++翻译（缺省到stdout）
+        if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--translate") {
+            Analyzer analyzer(argv[2], Analyzer::InputMode::File);
+            analyzer.analyzeQuiet();
+            std::string code;
+            if (!analyzer.translate(code)) {
+                std::cerr << analyzer.formatReport();
+                return 1;
+            }
+            if (argc == 4) {
+                std::ofstream out(argv[3]);
+                out << code;
+            } else {
+                std::cout << code;
+            }
+            return 0;
+        }
+
+        // --save-tokens <源> <blob>: token化后把token流序列化到文件
+        // --load-tokens <源> <blob>: 加载token流并跳过词法直接解析
+        if (argc == 4 && (std::string(argv[1]) == "--save-tokens" ||
+                          std::string(argv[1]) == "--load-tokens")) {
+            Analyzer analyzer(argv[2], Analyzer::InputMode::File);
+            if (std::string(argv[1]) == "--save-tokens") {
+                std::string blob = analyzer.serializeTokens();
+                std::ofstream out(argv[3], std::ios::binary);
+                if (!out) {
+                    std::cerr << "无法写入: " << argv[3] << "\n";
+                    return 1;
                 }
+                out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+                return 0;
             }
-            // 处理 else
-            else if (tokens[tokenPos].type == KEYWORD_ELSE) {
-                if (blockStack.empty() || blockStack.back() != "if") {
-                    errors.push_back("'else' 未匹配到 'if'");
-                    return;
+            std::ifstream in(argv[3], std::ios::binary);
+            std::string blob((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+            analyzer.adoptSerializedTokens(blob);
+            analyzer.analyze();
+            return 0;
+        }
+
+        // --stress: 对抗性结构压力测试，超线性耗时即非零退出
+        if (argc == 2 && std::string(argv[1]) == "--stress") {
+            return stress::run();
+        }
+
+        // --bench [KB...]: 对合成语料测词法/完整分析吞吐（缺省64/1024/16384KB）
+        // --gen <字节数> <路径>: 生成一份语料文件供固定语料复用
+        // 两者都接受 --ident=N（标识符长度）与 --decl=N（声明区百分比）
+        if (std::string(argv[1]) == "--bench" || std::string(argv[1]) == "--gen") {
+            bool genMode = std::string(argv[1]) == "--gen";
+            std::vector<size_t> numbers;
+            size_t identLen = 8;
+            unsigned declPercent = 20;
+            std::string genPath;
+            for (int i = 2; i < argc; i++) {
+                std::string arg = argv[i];
+                if (arg.rfind("--ident=", 0) == 0) {
+                    identLen = std::stoul(arg.substr(8));
+                } else if (arg.rfind("--decl=", 0) == 0) {
+                    declPercent = static_cast<unsigned>(std::stoul(arg.substr(7)));
+                } else if (!arg.empty() && arg[0] >= '0' && arg[0] <= '9') {
+                    numbers.push_back(std::stoul(arg));
+                } else {
+                    genPath = arg;
                 }
-                tokenPos++;
             }
-            else {
-                errors.push_back("意外的token: " + tokens[tokenPos].value);
-                tokenPos++;
-                return;
+            if (genMode) {
+                if (numbers.empty() || genPath.empty()) {
+                    std::cerr << "用法: --gen <字节数> <路径>\n";
+                    return 1;
+                }
+                std::ofstream out(genPath, std::ios::binary);
+                out << bench::generate(numbers[0], identLen, declPercent);
+                return 0;
             }
+            if (numbers.empty()) numbers = {64, 1024, 16384};
+            bench::run(numbers, identLen, declPercent);
+            return 0;
         }
-    
-        // 检查是否有未闭合的块
-        if (!blockStack.empty()) {
-            errors.push_back("缺少 'end' 来匹配 " + blockStack.back());
-            return;
+
+        unsigned parallel = 0;
+        bool useParallel = false;
+        bool batchMode = false;
+        bool recover = false;
+        bool emitStats = false;  // 每个文件分析后附一行JSON统计
+        bool emitNdjson = false; // 诊断改走NDJSON输出（每条错误一行）
+        bool sharedNamespace = false; // --batch时各单元共享声明命名空间
+        bool locate = false; // 文本报告附带行列位置
+        bool pipeline = false; // --batch走预读流水线（读盘与分析重叠）
+        std::string cachePath; // --cache=PATH: 按内容哈希持久化批跑结果
+        bool preScreen = false; // 预筛管线：只做词法与块配对检查
+        std::vector<std::string> paths;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("-j", 0) == 0) {
+                useParallel = true;
+                parallel = arg.size() > 2 ? static_cast<unsigned>(std::stoul(arg.substr(2))) : 0;
+            } else if (arg == "--batch") {
+                batchMode = true;
+            } else if (arg == "--recover") {
+                recover = true;
+            } else if (arg == "--stats") {
+                emitStats = true;
+            } else if (arg == "--ndjson") {
+                emitNdjson = true;
+            } else if (arg == "--shared-symbols") {
+                sharedNamespace = true;
+            } else if (arg == "--locate") {
+                locate = true;
+            } else if (arg == "--pipeline") {
+                pipeline = true;
+            } else if (arg.rfind("--cache=", 0) == 0) {
+                cachePath = arg.substr(8);
+            } else if (arg == "--prescreen") {
+                preScreen = true;
+            } else if (std::filesystem::is_directory(arg)) {
+                for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                    if (entry.is_regular_file()) paths.push_back(entry.path().string());
+                }
+            } else {
+                paths.push_back(arg);
+            }
         }
-    }
 
-    void reportErrors() {
-        if (errors.empty()) {
-            std::cout << "分析成功：未发现错误。\n";
-        } else {
-            std::cout << "发现错误：\n";
-            for (const auto& error : errors) {
-                std::cout << "- " << error << "\n";
+        if (batchMode) {
+            cache::ResultCache resultCache;
+            cache::ResultCache* cachePtr = nullptr;
+            if (!cachePath.empty()) {
+                resultCache.load(cachePath);
+                cachePtr = &resultCache;
+            }
+            auto results =
+                pipeline ? batch::runPipelined(paths, parallel, recover, emitStats,
+                                               emitNdjson, sharedNamespace, locate,
+                                               cachePtr, preScreen)
+                         : batch::run(paths, parallel, recover, emitStats,
+                                      emitNdjson, sharedNamespace, locate, cachePtr,
+                                      preScreen);
+            if (cachePtr != nullptr) {
+                resultCache.save(cachePath);
             }
+            for (const auto& result : results) {
+                if (emitNdjson) {
+                    std::cout << result.report; // 每行自带文件名
+                } else {
+                    std::cout << "\n文件: " << result.path << "\n" << result.report;
+                }
+            }
+            return 0;
         }
+
+        for (const auto& path : paths) {
+            if (!emitNdjson) {
+                std::cout << "\n文件: " << path << "\n";
+            }
+            Analyzer analyzer(path, Analyzer::InputMode::File);
+            if (recover) {
+                analyzer.enableErrorRecovery();
+            }
+            if (locate) {
+                analyzer.enableLocations();
+            }
+            if (emitStats) {
+                analyzer.enableStats();
+            }
+            if (useParallel) {
+                analyzer.lexInParallel(parallel);
+            }
+            if (preScreen) {
+                analyzer.analyzeQuiet<CheckLevel::LexOnly>();
+                std::cout << (emitNdjson ? analyzer.diagnosticsNdjson(path)
+                                         : analyzer.formatReport());
+            } else if (emitNdjson) {
+                analyzer.analyzeQuiet();
+                std::cout << analyzer.diagnosticsNdjson(path);
+            } else {
+                analyzer.analyze();
+            }
+            if (emitStats) {
+                std::cout << analyzer.statsJson() << "\n";
+            }
+        }
+        return 0;
     }
-};
 
-int main() {
     std::vector<std::string> testCases = {
         "Var i,j:integer;Begin i:=0;j:=1;End",           // 正确示例
         "Vari:integer;",                                 // var后缺少空格